@@ -0,0 +1,1281 @@
+#include "archive.h"
+#include "parallelinflate.h"
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// --- Recycling allocator for miniz ---
+// miniz allocates the same few blocks for every archive it opens and every part it streams
+// (reader state, central directory arrays, iterator state, read buffer and dictionary).
+// Freed blocks are parked per thread and handed out again for requests of a similar size.
+// Each block records its capacity in a header, so it does not matter which thread frees it.
+struct BlockHeader
+{
+    size_t capacity;
+    size_t reserved;    // Keeps the payload 16-byte aligned on 64-bit builds
+};
+
+const int kMaxParkedBlocks = 16;
+
+struct BlockCache
+{
+    BlockHeader* blocks[kMaxParkedBlocks];
+    int count = 0;
+
+    ~BlockCache()
+    {
+        while (count > 0)
+            free(blocks[--count]);
+    }
+};
+
+thread_local BlockCache t_blockCache;
+thread_local ArchiveScratch t_scratch;
+
+// Scratch memory a thread keeps between sessions. Buffers beyond it are freed when the session ends, so that one
+// huge part does not stay pinned on every thread that has read one.
+const size_t kMaxRetainedScratch = 4 * 1024 * 1024;
+
+void TrimScratch(ArchiveScratch& scratch)
+{
+    size_t retained = scratch.readBuffer.capacity() + scratch.chunk.capacity();
+    for (std::vector<char>& buffer : scratch.parts)
+    {
+        if (retained + buffer.capacity() > kMaxRetainedScratch)
+            std::vector<char>().swap(buffer);
+        retained += buffer.capacity();
+    }
+}
+
+void* RecyclingAlloc(void*, size_t items, size_t size)
+{
+    if (size != 0 && items > (SIZE_MAX - sizeof(BlockHeader)) / size)
+        return nullptr;
+    size_t bytes = items * size;
+
+    BlockCache& cache = t_blockCache;
+    for (int i = cache.count - 1; i >= 0; --i) {
+        BlockHeader* header = cache.blocks[i];
+        if (header->capacity >= bytes && header->capacity / 2 <= bytes) {
+            cache.blocks[i] = cache.blocks[--cache.count];
+            return header + 1;
+        }
+    }
+
+    BlockHeader* header = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + bytes));
+    if (!header)
+        return nullptr;
+    header->capacity = bytes;
+    return header + 1;
+}
+
+void RecyclingFree(void*, void* address)
+{
+    if (!address)
+        return;
+
+    BlockHeader* header = static_cast<BlockHeader*>(address) - 1;
+    BlockCache& cache = t_blockCache;
+    if (cache.count < kMaxParkedBlocks)
+        cache.blocks[cache.count++] = header;
+    else
+        free(header);
+}
+
+void* RecyclingRealloc(void* opaque, void* address, size_t items, size_t size)
+{
+    if (!address)
+        return RecyclingAlloc(opaque, items, size);
+    if (size != 0 && items > (SIZE_MAX - sizeof(BlockHeader)) / size)
+        return nullptr;
+    size_t bytes = items * size;
+
+    BlockHeader* header = static_cast<BlockHeader*>(address) - 1;
+    if (header->capacity >= bytes)
+        return address;
+
+    header = static_cast<BlockHeader*>(realloc(header, sizeof(BlockHeader) + bytes));
+    if (!header)
+        return nullptr;
+    header->capacity = bytes;
+    return header + 1;
+}
+
+// --- Part name hashing ---
+// Names are compared case-insensitively, as miniz does. Longer names than this are left to miniz.
+const size_t kMaxIndexedNameLength = 1024;
+
+char FoldNameChar(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+uint32_t HashPartName(const char* name, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ static_cast<unsigned char>(FoldNameChar(name[i]))) * 16777619u;
+    return hash;
+}
+
+bool PartNamesEqual(const char* a, const char* b, size_t length)
+{
+    for (size_t i = 0; i < length; ++i)
+    {
+        if (FoldNameChar(a[i]) != FoldNameChar(b[i]))
+            return false;
+    }
+    return true;
+}
+
+// Copies the entry's name into a buffer of kMaxIndexedNameLength bytes and returns its length. Names that do not
+// fit whole are not copied, and kMaxIndexedNameLength is returned for them.
+size_t GetIndexedName(mz_zip_archive* zip, mz_uint fileIndex, char* name)
+{
+    mz_uint size = mz_zip_reader_get_filename(zip, fileIndex, nullptr, 0);
+    if (size == 0 || size > kMaxIndexedNameLength)
+        return kMaxIndexedNameLength;
+    mz_zip_reader_get_filename(zip, fileIndex, name, static_cast<mz_uint>(kMaxIndexedNameLength));
+    return size - 1;
+}
+
+// --- In-page errors ---
+// Mapped archives are read in place. Touching the view raises EXCEPTION_IN_PAGE_ERROR when the drive fails or
+// goes away, so every call that may read it runs through GuardedRead, which turns the fault into a failed read.
+// read must be a lambda around C calls or plain memory reads, as nothing is unwound.
+template <typename Read>
+bool GuardedRead(Read read)
+{
+#ifdef _WIN32
+    __try
+    {
+        read();
+    }
+    __except (GetExceptionCode() == EXCEPTION_IN_PAGE_ERROR ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+    {
+        return false;
+    }
+#else
+    read();
+#endif
+    return true;
+}
+
+// Reads one byte of every page of the range under the guard, so that a view handed out afterwards has been
+// paged in once without a fault. A drive that fails after this is not caught.
+bool PageIn(const unsigned char* data, size_t size)
+{
+    const size_t kPageSize = 4096;
+    return GuardedRead([=]
+    {
+        volatile unsigned char sink = 0;
+        for (size_t offset = 0; offset < size; offset += kPageSize)
+            sink = sink + data[offset];
+        if (size > 0)
+            sink = sink + data[size - 1];
+    });
+}
+
+// --- Reader pool ---
+// Total Commander asks for the columns of a file one after another, so the reader of the last few
+// files is kept open. A janitor thread closes readers once they have been idle for a while, so that
+// files are not left mapped or open, and so locked against saving or deleting, after browsing stops.
+// It runs only while the pool holds readers.
+const size_t kMaxPooledReaders = 8;
+const std::chrono::seconds kReaderIdleTimeout(5);
+
+struct PooledReader
+{
+    std::unique_ptr<ArchiveReader> reader;
+    std::chrono::steady_clock::time_point released;
+};
+
+std::mutex g_readerPoolMutex;
+std::condition_variable g_readerPoolChanged;
+bool g_readerJanitorRunning = false;
+
+// Most recently released first. Never destroyed: at process exit the thread-local block cache that
+// miniz frees into may already be gone, so readers still pooled then are left to the OS.
+std::list<PooledReader>& ReaderPool()
+{
+    static std::list<PooledReader>* pool = new std::list<PooledReader>();
+    return *pool;
+}
+
+// Joined by CloseArchiveReaders, or by the next start once it has finished. Never destroyed, as a
+// std::thread that is still joinable at process exit would terminate it.
+std::thread& ReaderJanitorThread()
+{
+    static std::thread* janitor = new std::thread();
+    return *janitor;
+}
+
+void ExpireIdleReaders(std::list<PooledReader>& closing)
+{
+    std::list<PooledReader>& pool = ReaderPool();
+    auto now = std::chrono::steady_clock::now();
+    while (!pool.empty() && now - pool.back().released >= kReaderIdleTimeout)
+        closing.splice(closing.end(), pool, std::prev(pool.end()));
+}
+
+// Sleeps until the least recently released reader expires and closes it, until the pool is empty
+void ReaderJanitor()
+{
+    std::unique_lock<std::mutex> lock(g_readerPoolMutex);
+    std::list<PooledReader>& pool = ReaderPool();
+    while (!pool.empty())
+    {
+        std::list<PooledReader> closing;
+        ExpireIdleReaders(closing);
+        if (!closing.empty())
+        {
+            lock.unlock();
+            closing.clear();
+            lock.lock();
+            continue;
+        }
+        g_readerPoolChanged.wait_until(lock, pool.back().released + kReaderIdleTimeout);
+    }
+    g_readerJanitorRunning = false;
+}
+
+// Called with the pool locked after a reader was added
+void StartReaderJanitor()
+{
+    if (g_readerJanitorRunning)
+        return;
+
+    // A previous janitor has left its loop and needs no lock to finish
+    std::thread& janitor = ReaderJanitorThread();
+    if (janitor.joinable())
+        janitor.join();
+    try
+    {
+        janitor = std::thread(ReaderJanitor);
+        g_readerJanitorRunning = true;
+    }
+    catch (const std::system_error&)
+    {
+        // Idle readers are then closed by the next pool call
+    }
+}
+
+} // namespace
+
+bool MappedFile::Open(const char* path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0 || static_cast<ULONGLONG>(size.QuadPart) > SIZE_MAX) {
+        CloseHandle(file);
+        return false;
+    }
+
+    // The mapping object keeps the file open, so the file handle is not needed any more
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping)
+        return false;
+
+    const void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+
+    m_mapping = mapping;
+    m_data = view;
+    m_size = static_cast<size_t>(size.QuadPart);
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0 || static_cast<unsigned long long>(st.st_size) > SIZE_MAX) {
+        close(fd);
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED)
+        return false;
+
+    m_data = view;
+    m_size = static_cast<size_t>(st.st_size);
+#endif
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (!m_data)
+        return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(m_data);
+    CloseHandle(m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap(const_cast<void*>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+bool PlannedFile::Open(const char* path)
+{
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    m_file = file;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+        Close();
+        return false;
+    }
+    m_size = static_cast<mz_uint64>(size.QuadPart);
+#else
+    m_file = open(path, O_RDONLY);
+    if (m_file < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(m_file, &st) != 0 || st.st_size <= 0) {
+        Close();
+        return false;
+    }
+    m_size = static_cast<mz_uint64>(st.st_size);
+#endif
+
+    try
+    {
+        if (m_size <= kWholeFileLimit)
+        {
+            // One read is all it takes, and the archive can then be handled like a mapped one
+            m_whole.resize(static_cast<size_t>(m_size));
+            bool read = ReadAt(0, m_whole.data(), m_whole.size());
+#ifdef _WIN32
+            CloseHandle(m_file);
+            m_file = nullptr;
+#else
+            close(m_file);
+            m_file = -1;
+#endif
+            if (!read)
+                Close();
+            return read;
+        }
+        ReadTail();
+    }
+    catch (const std::bad_alloc&)
+    {
+        // Without a buffer for the plan every read simply goes to the file
+        m_whole.clear();
+        m_ranges.clear();
+        m_tailRanges = 0;
+    }
+    return true;
+}
+
+void PlannedFile::Close()
+{
+#ifdef _WIN32
+    if (m_file)
+        CloseHandle(m_file);
+    m_file = nullptr;
+#else
+    if (m_file >= 0)
+        close(m_file);
+    m_file = -1;
+#endif
+    m_size = 0;
+    m_whole.clear();
+    m_ranges.clear();
+    m_tailRanges = 0;
+}
+
+bool PlannedFile::ReadAt(mz_uint64 offset, void* buffer, size_t size)
+{
+    char* out = static_cast<char*>(buffer);
+    while (size > 0)
+    {
+#ifdef _WIN32
+        if (!m_file)
+            return false;
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = static_cast<DWORD>(offset);
+        overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+        DWORD request = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+        DWORD read = 0;
+        if (!ReadFile(m_file, out, request, &read, &overlapped) || read == 0)
+            return false;
+#else
+        if (m_file < 0)
+            return false;
+        ssize_t read = pread(m_file, out, size, static_cast<off_t>(offset));
+        if (read <= 0)
+            return false;
+#endif
+        out += read;
+        offset += read;
+        size -= read;
+    }
+    return true;
+}
+
+// Reads the last kTailSize bytes, or from the start of the central directory if that lies further back
+void PlannedFile::ReadTail()
+{
+    Range tail;
+    tail.offset = m_size > kTailSize ? m_size - kTailSize : 0;
+    tail.data.resize(static_cast<size_t>(m_size - tail.offset));
+    if (!ReadAt(tail.offset, tail.data.data(), tail.data.size()))
+        return;
+
+    // The end of central directory record is 22 bytes plus a comment of up to 64 KB
+    const unsigned char* base = reinterpret_cast<const unsigned char*>(tail.data.data());
+    for (size_t pos = tail.data.size() >= 22 ? tail.data.size() - 22 + 1 : 0; pos-- > 0;)
+    {
+        if (MZ_READ_LE32(base + pos) != 0x06054b50)
+            continue;
+
+        mz_uint64 directorySize = MZ_READ_LE32(base + pos + 12);
+        mz_uint64 directoryOffset = MZ_READ_LE32(base + pos + 16);
+        // Zip64 archives mark the fields as 0xFFFFFFFF; miniz reads those through the on-demand path
+        if (directoryOffset < tail.offset && directoryOffset + directorySize <= m_size && directorySize != 0xFFFFFFFF &&
+            m_size - directoryOffset <= kMaxRangeSize)
+        {
+            Range directory;
+            directory.offset = directoryOffset;
+            directory.data.resize(static_cast<size_t>(m_size - directoryOffset));
+            if (ReadAt(directory.offset, directory.data.data(), directory.data.size()))
+            {
+                m_ranges.push_back(std::move(directory));
+                m_tailRanges = m_ranges.size();
+                return;
+            }
+        }
+        break;
+    }
+
+    m_ranges.push_back(std::move(tail));
+    m_tailRanges = m_ranges.size();
+}
+
+const PlannedFile::Range* PlannedFile::FindRange(mz_uint64 offset, size_t size) const
+{
+    for (const Range& range : m_ranges)
+    {
+        if (offset >= range.offset && offset + size <= range.offset + range.data.size())
+            return &range;
+    }
+    return nullptr;
+}
+
+void PlannedFile::Prefetch(std::vector<std::pair<mz_uint64, mz_uint64>> ranges)
+{
+    if (!m_whole.empty() || m_size == 0)
+        return;
+
+    // Drop what is held already, then merge neighbours so that each merged range costs one request
+    ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [&](const std::pair<mz_uint64, mz_uint64>& range)
+        {
+            return range.second == 0 || range.second > kMaxRangeSize || range.first >= m_size ||
+                FindRange(range.first, static_cast<size_t>(std::min(range.second, m_size - range.first)));
+        }), ranges.end());
+    std::sort(ranges.begin(), ranges.end());
+
+    for (size_t i = 0; i < ranges.size();)
+    {
+        mz_uint64 begin = ranges[i].first;
+        mz_uint64 end = std::min(begin + ranges[i].second, m_size);
+        for (++i; i < ranges.size() && ranges[i].first <= end + kCoalesceGap; ++i)
+        {
+            mz_uint64 next = std::min(ranges[i].first + ranges[i].second, m_size);
+            if (next - begin > kMaxRangeSize)
+                break;
+            end = std::max(end, next);
+        }
+
+        try
+        {
+            Range range;
+            range.offset = begin;
+            range.data.resize(static_cast<size_t>(end - begin));
+            if (ReadAt(range.offset, range.data.data(), range.data.size()))
+                m_ranges.push_back(std::move(range));
+        }
+        catch (const std::bad_alloc&)
+        {
+            return;
+        }
+    }
+}
+
+size_t PlannedFile::Read(void* opaque, mz_uint64 offset, void* buffer, size_t size)
+{
+    PlannedFile* file = static_cast<PlannedFile*>(opaque);
+    if (offset >= file->m_size)
+        return 0;
+    if (size > file->m_size - offset)
+        size = static_cast<size_t>(file->m_size - offset);
+
+    if (!file->m_whole.empty())
+    {
+        memcpy(buffer, file->m_whole.data() + offset, size);
+        return size;
+    }
+    if (const Range* range = file->FindRange(offset, size))
+    {
+        memcpy(buffer, range->data.data() + (offset - range->offset), size);
+        return size;
+    }
+    return file->ReadAt(offset, buffer, size) ? size : 0;
+}
+
+ArchiveBackend PreferredArchiveBackend(const char* path)
+{
+#ifdef _WIN32
+    auto isSeparator = [](char c) { return c == '\\' || c == '/'; };
+
+    // Long paths (\\?\C:\..., \\?\UNC\server\...) are judged by what follows the prefix; other UNC paths
+    // are network shares
+    if (isSeparator(path[0]) && isSeparator(path[1]))
+    {
+        if ((path[2] != '?' && path[2] != '.') || !isSeparator(path[3]))
+            return ARCHIVE_BACKEND_PLANNED;
+        path += 4;
+        if (_strnicmp(path, "UNC", 3) == 0 && isSeparator(path[3]))
+            return ARCHIVE_BACKEND_PLANNED;
+        if (path[0] == '\0' || path[1] != ':')
+            return ARCHIVE_BACKEND_FILE;
+    }
+
+    // Only fixed drives are mapped. Removable and optical media are read with stdio, which reports a drive that
+    // went away as a read error.
+    char root[] = { path[0], ':', '\\', '\0' };
+    switch (GetDriveTypeA(path[0] != '\0' && path[1] == ':' ? root : nullptr))
+    {
+    case DRIVE_REMOTE:
+        return ARCHIVE_BACKEND_PLANNED;
+    case DRIVE_FIXED:
+    case DRIVE_RAMDISK:
+        return ARCHIVE_BACKEND_MAPPED;
+    default:
+        return ARCHIVE_BACKEND_FILE;
+    }
+#else
+    (void)path;
+    return ARCHIVE_BACKEND_MAPPED;
+#endif
+}
+
+bool GetArchiveIdentity(const char* path, ArchiveIdentity& identity)
+{
+#ifdef _WIN32
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data))
+        return false;
+    identity.size = (static_cast<mz_uint64>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    identity.lastWrite = (static_cast<mz_uint64>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+    struct stat st;
+    if (stat(path, &st) != 0)
+        return false;
+    identity.size = static_cast<mz_uint64>(st.st_size);
+    identity.lastWrite = static_cast<mz_uint64>(st.st_mtim.tv_sec) * 1000000000u + static_cast<mz_uint64>(st.st_mtim.tv_nsec);
+#endif
+    return true;
+}
+
+ArchiveReader::ArchiveReader(const char* path, ArchiveBackend backend, ArchiveIndex index)
+    : m_path(path), m_backend(backend), m_index(index)
+{
+    // Taken before opening, so that a change while the reader is open makes it look stale rather than current
+    m_hasIdentity = GetArchiveIdentity(path, m_identity);
+
+    memset(&m_zip, 0, sizeof(m_zip));
+    m_zip.m_pAlloc = RecyclingAlloc;
+    m_zip.m_pFree = RecyclingFree;
+    m_zip.m_pRealloc = RecyclingRealloc;
+    mz_uint flags = index == ARCHIVE_INDEX_HASHED ? MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY : 0;
+    if (backend == ARCHIVE_BACKEND_MAPPED && m_mappedFile.Open(path))
+    {
+        // miniz copies the central directory out of the view here; a fault leaves its state half built
+        m_open = false;
+        if (!GuardedRead([&] { m_open = mz_zip_reader_init_mem(&m_zip, m_mappedFile.Data(), m_mappedFile.Size(), flags) != MZ_FALSE; }))
+            mz_zip_reader_end(&m_zip);
+    }
+    else if (backend == ARCHIVE_BACKEND_PLANNED && m_plannedFile.Open(path))
+    {
+        if (m_plannedFile.Data())
+        {
+            m_open = mz_zip_reader_init_mem(&m_zip, m_plannedFile.Data(), static_cast<size_t>(m_plannedFile.Size()), flags) != MZ_FALSE;
+        }
+        else
+        {
+            m_zip.m_pRead = PlannedFile::Read;
+            m_zip.m_pIO_opaque = &m_plannedFile;
+            m_open = mz_zip_reader_init(&m_zip, m_plannedFile.Size(), flags) != MZ_FALSE;
+        }
+    }
+    else
+    {
+        m_open = mz_zip_reader_init_file(&m_zip, path, flags) != MZ_FALSE;
+    }
+}
+
+ArchiveReader::~ArchiveReader()
+{
+    if (m_open)
+        mz_zip_reader_end(&m_zip);
+}
+
+const unsigned char* ArchiveReader::Data() const
+{
+    const void* data = m_mappedFile.Data() ? m_mappedFile.Data() : m_plannedFile.Data();
+    return static_cast<const unsigned char*>(data);
+}
+
+mz_uint64 ArchiveReader::Size() const
+{
+    return m_mappedFile.Data() ? m_mappedFile.Size() : m_plannedFile.Size();
+}
+
+int ArchiveReader::Locate(const char* name)
+{
+    size_t length = strlen(name);
+    if (m_index != ARCHIVE_INDEX_HASHED || length >= kMaxIndexedNameLength)
+        return mz_zip_reader_locate_file(&m_zip, name, nullptr, 0);
+
+    std::call_once(m_nameIndexOnce, &ArchiveReader::BuildNameIndex, this);
+    const std::vector<uint64_t>& table = m_nameIndex;
+    if (table.empty())
+        return mz_zip_reader_locate_file(&m_zip, name, nullptr, 0);
+
+    size_t mask = table.size() - 1;
+    uint32_t hash = HashPartName(name, length);
+    char entryName[kMaxIndexedNameLength];
+    for (size_t slot = hash & mask; table[slot] != 0; slot = (slot + 1) & mask)
+    {
+        if (static_cast<uint32_t>(table[slot] >> 32) != hash)
+            continue;
+        mz_uint fileIndex = static_cast<mz_uint>(table[slot] & 0xFFFFFFFFu) - 1;
+        size_t entryLength = GetIndexedName(&m_zip, fileIndex, entryName);
+        if (entryLength == length && PartNamesEqual(entryName, name, length))
+            return static_cast<int>(fileIndex);
+    }
+    return -1;
+}
+
+// Mapped and planned archives are read with memcpy or positional reads, and lookups leave the reader untouched.
+// miniz records extraction errors in the archive, so concurrent extraction goes through copies of it.
+bool ArchiveReader::SupportsConcurrentReads() const
+{
+    return m_open && (Data() || m_zip.m_pRead == PlannedFile::Read);
+}
+
+void ArchiveReader::BuildNameIndex()
+{
+    std::vector<uint64_t>& table = m_nameIndex;
+    table.clear();
+
+    // Open addressing at no more than half load; an entry is the name hash above index + 1, 0 marks a free slot
+    mz_uint numFiles = mz_zip_reader_get_num_files(&m_zip);
+    size_t capacity = 16;
+    while (capacity < static_cast<size_t>(numFiles) * 2)
+        capacity *= 2;
+    try
+    {
+        table.assign(capacity, 0);
+    }
+    catch (const std::bad_alloc&)
+    {
+        // Lookups fall back to miniz scanning the unsorted directory
+        table.clear();
+        return;
+    }
+
+    // Entries are inserted in directory order, so a lookup finds the first of several equal names like miniz does.
+    // Names too long to be indexed can only be looked up by miniz, which Locate does for names of their length.
+    size_t mask = capacity - 1;
+    char entryName[kMaxIndexedNameLength];
+    for (mz_uint i = 0; i < numFiles; ++i)
+    {
+        size_t length = GetIndexedName(&m_zip, i, entryName);
+        if (length >= kMaxIndexedNameLength)
+            continue;
+        uint32_t hash = HashPartName(entryName, length);
+        size_t slot = hash & mask;
+        while (table[slot] != 0)
+            slot = (slot + 1) & mask;
+        table[slot] = (static_cast<uint64_t>(hash) << 32) | (static_cast<uint64_t>(i) + 1);
+    }
+}
+
+std::unique_ptr<ArchiveReader> AcquireArchiveReader(const char* path, ArchiveBackend backend, ArchiveIndex index)
+{
+    ArchiveIdentity identity;
+    if (GetArchiveIdentity(path, identity))
+    {
+        std::list<PooledReader> closing;    // Destroyed after the lock is released
+        std::lock_guard<std::mutex> lock(g_readerPoolMutex);
+        std::list<PooledReader>& pool = ReaderPool();
+        ExpireIdleReaders(closing);
+        for (auto it = pool.begin(); it != pool.end(); ++it)
+        {
+            ArchiveReader& reader = *it->reader;
+            if (reader.Path() != path || reader.Backend() != backend || reader.Index() != index)
+                continue;
+
+            if (reader.Identity() == identity)
+            {
+                std::unique_ptr<ArchiveReader> found = std::move(it->reader);
+                pool.erase(it);
+                return found;
+            }
+            // The file has changed since the reader was opened
+            closing.splice(closing.end(), pool, it);
+            break;
+        }
+    }
+    return std::unique_ptr<ArchiveReader>(new ArchiveReader(path, backend, index));
+}
+
+void ReleaseArchiveReader(std::unique_ptr<ArchiveReader> reader)
+{
+    if (!reader || !reader->IsOpen() || !reader->HasIdentity())
+        return;
+    reader->Planned().DropPrefetched();
+
+    std::list<PooledReader> closing;
+    std::lock_guard<std::mutex> lock(g_readerPoolMutex);
+    std::list<PooledReader>& pool = ReaderPool();
+    ExpireIdleReaders(closing);
+
+    // Another session may have opened the same file meanwhile; the reader released last wins
+    for (auto it = pool.begin(); it != pool.end();)
+    {
+        ArchiveReader& other = *it->reader;
+        if (other.Path() == reader->Path() && other.Backend() == reader->Backend() && other.Index() == reader->Index())
+            closing.splice(closing.end(), pool, it++);
+        else
+            ++it;
+    }
+
+    PooledReader pooled;
+    pooled.reader = std::move(reader);
+    pooled.released = std::chrono::steady_clock::now();
+    pool.push_front(std::move(pooled));
+    while (pool.size() > kMaxPooledReaders)
+        closing.splice(closing.end(), pool, std::prev(pool.end()));
+    StartReaderJanitor();
+}
+
+void CloseArchiveReaders()
+{
+    std::list<PooledReader> closing;
+    std::thread janitor;
+    {
+        std::lock_guard<std::mutex> lock(g_readerPoolMutex);
+        closing.swap(ReaderPool());
+        janitor.swap(ReaderJanitorThread());
+        g_readerPoolChanged.notify_all();
+    }
+
+    // The janitor finds the pool empty and returns
+    if (janitor.joinable())
+        janitor.join();
+}
+
+ArchiveSession::ArchiveSession(const char* zipPath, ArchiveBackend backend, ArchiveIndex index)
+{
+    std::swap(m_scratch, t_scratch);
+
+    m_reader = AcquireArchiveReader(zipPath, backend, index);
+    m_zip = m_reader->Zip();
+    m_open = m_reader->IsOpen();
+}
+
+ArchiveSession::~ArchiveSession()
+{
+    // Parts viewed in the archive image go away with the session, so the reader can be handed on
+    m_parts.clear();
+    ReleaseArchiveReader(std::move(m_reader));
+
+    // Views into the scratch buffers die with the session, so the buffers can go back to the thread
+    TrimScratch(m_scratch);
+    std::swap(m_scratch, t_scratch);
+}
+
+bool ArchiveSession::HasPart(const char* name)
+{
+    return m_open && LocatePart(name) >= 0;
+}
+
+bool ArchiveSession::GetPartSize(const char* name, size_t& size)
+{
+    if (!m_open)
+        return false;
+
+    int fileIndex = LocatePart(name);
+    mz_zip_archive_file_stat file_stat;
+    if (fileIndex < 0 || !mz_zip_reader_file_stat(m_zip, fileIndex, &file_stat) || file_stat.m_uncomp_size > SIZE_MAX)
+        return false;
+    size = static_cast<size_t>(file_stat.m_uncomp_size);
+    return true;
+}
+
+const PartBuffer* ArchiveSession::GetPart(const char* name)
+{
+    if (!m_open || IsCancelled())
+        return nullptr;
+
+    int fileIndex = LocatePart(name);
+    if (fileIndex < 0)
+        return nullptr;
+
+    return GetPart(static_cast<mz_uint>(fileIndex));
+}
+
+const PartBuffer* ArchiveSession::GetPart(mz_uint fileIndex)
+{
+    auto it = m_parts.find(fileIndex);
+    if (it != m_parts.end())
+        return &it->second;
+    if (m_failedParts.count(fileIndex))
+        return nullptr;
+
+    PartBuffer view;
+    if (GetStoredView(fileIndex, view))
+        return &(m_parts[fileIndex] = view);
+
+    PartBuffer& part = m_parts[fileIndex];
+    if (!InflatePart(fileIndex, part))
+    {
+        m_parts.erase(fileIndex);
+        m_failedParts[fileIndex] = true;
+        return nullptr;
+    }
+    return &part;
+}
+
+// Inflates a part into the next free scratch buffer.
+bool ArchiveSession::InflatePart(mz_uint fileIndex, PartBuffer& part)
+{
+    mz_zip_archive_file_stat file_stat;
+    if (!mz_zip_reader_file_stat(m_zip, fileIndex, &file_stat))
+        return false;
+    if (file_stat.m_uncomp_size > SIZE_MAX / 2)
+        return false;
+    size_t size = static_cast<size_t>(file_stat.m_uncomp_size);
+
+    std::vector<char>* buffer = AcquireScratchBuffer(size);
+    if (!buffer)
+        return false;
+
+    // An archive in memory is inflated straight from there; otherwise miniz reads through our buffer
+    void* readBuffer = nullptr;
+    size_t readBufferSize = 0;
+    if (!m_reader->Data())
+    {
+        try
+        {
+            m_scratch.readBuffer.resize(MZ_ZIP_MAX_IO_BUF_SIZE);
+        }
+        catch (const std::bad_alloc&)
+        {
+            m_scratchPartsInUse--;
+            return false;
+        }
+        readBuffer = m_scratch.readBuffer.data();
+        readBufferSize = m_scratch.readBuffer.size();
+    }
+
+    mz_uint flags = m_verifyCrc ? 0 : MZ_ZIP_FLAG_SKIP_CRC32_CHECK;
+    mz_bool extracted = MZ_FALSE;
+    if (!GuardedRead([&] { extracted = mz_zip_reader_extract_to_mem_no_alloc(m_zip, fileIndex, buffer->data(), size, flags, readBuffer, readBufferSize); }) ||
+        !extracted)
+    {
+        m_scratchPartsInUse--;
+        return false;
+    }
+
+    part.data = buffer->data();
+    part.size = size;
+    part.mapped = false;
+    return true;
+}
+
+// Claims the next scratch buffer with room for size bytes plus a terminator.
+std::vector<char>* ArchiveSession::AcquireScratchBuffer(size_t size)
+{
+    if (m_scratchPartsInUse == m_scratch.parts.size())
+        m_scratch.parts.emplace_back();
+    std::vector<char>& buffer = m_scratch.parts[m_scratchPartsInUse];
+    try
+    {
+        buffer.resize(size + 1);
+    }
+    catch (const std::bad_alloc&)
+    {
+        return nullptr;
+    }
+    m_scratchPartsInUse++;
+    return &buffer;
+}
+
+char* ArchiveSession::TakePart(const char* name, size_t& size)
+{
+    if (!m_open || IsCancelled())
+        return nullptr;
+
+    int fileIndex = LocatePart(name);
+    if (fileIndex < 0)
+        return nullptr;
+
+    const PartBuffer* part = GetPart(static_cast<mz_uint>(fileIndex));
+    if (!part)
+        return nullptr;
+
+    // Inflated parts already live in a scratch buffer of ours; stored ones are copied out of the archive
+    char* buffer = const_cast<char*>(part->data);
+    if (part->mapped)
+    {
+        std::vector<char>* copy = AcquireScratchBuffer(part->size);
+        if (!copy || !GuardedRead([&] { memcpy(copy->data(), part->data, part->size); }))
+            return nullptr;
+        buffer = copy->data();
+    }
+
+    size = part->size;
+    m_parts.erase(fileIndex);
+    return buffer;
+}
+
+// Locates the data of a stored (uncompressed) entry inside the archive image. Returns false for
+// compressed entries, when the archive is not in memory, or when the entry does not check out.
+bool ArchiveSession::GetStoredView(mz_uint fileIndex, PartBuffer& view)
+{
+    if (!m_reader->Data())
+        return false;
+
+    mz_zip_archive_file_stat file_stat;
+    if (!mz_zip_reader_file_stat(m_zip, fileIndex, &file_stat))
+        return false;
+    if (file_stat.m_method != 0 || file_stat.m_is_encrypted || !file_stat.m_is_supported ||
+        file_stat.m_comp_size != file_stat.m_uncomp_size)
+        return false;
+
+    mz_uint64 dataOffset;
+    if (!GetDataOffset(file_stat, dataOffset))
+        return false;
+
+    // Checking the CRC pages the view in; without the check it is paged in explicitly. Either way a failing
+    // drive shows up here rather than in the caller.
+    const unsigned char* base = m_reader->Data() + dataOffset;
+    size_t size = static_cast<size_t>(file_stat.m_comp_size);
+    mz_ulong crc = 0;
+    if (m_verifyCrc)
+    {
+        if (!GuardedRead([&] { crc = mz_crc32(MZ_CRC32_INIT, base, size); }) || crc != file_stat.m_crc32)
+            return false;
+    }
+    else if (!PageIn(base, size))
+    {
+        return false;
+    }
+
+    view.data = reinterpret_cast<const char*>(base);
+    view.size = size;
+    view.mapped = true;
+    return true;
+}
+
+// Finds the entry's data behind its local header, which has 30 fixed bytes followed by the file name and extra
+// field. Fails if the header is damaged or the data would run past the end of the archive.
+bool ArchiveSession::GetDataOffset(const mz_zip_archive_file_stat& file_stat, mz_uint64& offset)
+{
+    unsigned char header[30];
+    size_t read = 0;
+    if (!GuardedRead([&] { read = m_zip->m_pRead(m_zip->m_pIO_opaque, file_stat.m_local_header_ofs, header, sizeof(header)); }) ||
+        read != sizeof(header) || MZ_READ_LE32(header) != 0x04034b50)
+        return false;
+
+    offset = file_stat.m_local_header_ofs + sizeof(header) + MZ_READ_LE16(header + 26) + MZ_READ_LE16(header + 28);
+    return offset + file_stat.m_comp_size <= m_zip->m_archive_size;
+}
+
+// Streams a large deflated part with ParallelInflate. Returns false if the part does not qualify or its stream
+// could not be split, with delivered set to the bytes already passed to sink; otherwise ok is the result for
+// StreamPart.
+bool ArchiveSession::StreamPartParallel(mz_uint fileIndex, const std::function<bool(const char* data, size_t size)>& sink,
+                                        bool& ok, mz_uint64& delivered)
+{
+    delivered = 0;
+    mz_zip_archive_file_stat file_stat;
+    if (!mz_zip_reader_file_stat(m_zip, fileIndex, &file_stat))
+        return false;
+    if (file_stat.m_method != MZ_DEFLATED || file_stat.m_is_encrypted || !file_stat.m_is_supported ||
+        file_stat.m_uncomp_size < m_parallelMinSize || file_stat.m_comp_size > SIZE_MAX / 2)
+        return false;
+
+    mz_uint64 dataOffset;
+    if (!GetDataOffset(file_stat, dataOffset))
+        return false;
+
+    // The whole compressed stream has to be in memory; archives that are not are read into a buffer of the size
+    // of the part's compressed data. ParallelInflate reads a mapping on its own threads, out of reach of the
+    // guard, so the stream is paged in under it first.
+    size_t size = static_cast<size_t>(file_stat.m_comp_size);
+    const unsigned char* data = nullptr;
+    std::vector<unsigned char> compressed;
+    if (m_reader->Data())
+    {
+        data = m_reader->Data() + dataOffset;
+        if (!PageIn(data, size))
+            return false;
+    }
+    else
+    {
+        try
+        {
+            compressed.resize(size);
+        }
+        catch (const std::bad_alloc&)
+        {
+            return false;
+        }
+        if (m_zip->m_pRead(m_zip->m_pIO_opaque, dataOffset, compressed.data(), size) != size)
+            return false;
+        data = compressed.data();
+    }
+
+    // A chunk's output can run to tens of megabytes; it is passed on in slices so that a cancellation is noticed
+    mz_ulong crc = MZ_CRC32_INIT;
+    uint64_t passed = 0;
+    ParallelInflateStatus status = ParallelInflate(data, size, m_parallelThreads,
+        [&](const char* piece, size_t pieceSize)
+        {
+            for (size_t offset = 0; offset < pieceSize; offset += kParallelSliceSize)
+            {
+                size_t slice = pieceSize - offset < kParallelSliceSize ? pieceSize - offset : kParallelSliceSize;
+                if (IsCancelled())
+                    return false;
+                if (m_verifyCrc)
+                    crc = mz_crc32(crc, reinterpret_cast<const unsigned char*>(piece + offset), slice);
+                if (!sink(piece + offset, slice))
+                    return false;
+            }
+            return true;
+        }, passed);
+    delivered = passed;
+
+    if (status == PARALLEL_INFLATE_FAILED)
+        return false;
+    ok = status == PARALLEL_INFLATE_STOPPED ||
+         (passed == file_stat.m_uncomp_size && (!m_verifyCrc || crc == file_stat.m_crc32));
+    return true;
+}
+
+bool ArchiveSession::StreamPart(const char* name, const std::function<bool(const char* data, size_t size)>& sink)
+{
+    if (!m_open || IsCancelled())
+        return false;
+
+    int fileIndex = LocatePart(name);
+    if (fileIndex < 0)
+        return false;
+
+    // Parts that are already in memory, or stored in the mapping, are passed in one piece
+    const PartBuffer* part = nullptr;
+    auto it = m_parts.find(fileIndex);
+    if (it != m_parts.end())
+    {
+        part = &it->second;
+    }
+    else
+    {
+        PartBuffer view;
+        if (GetStoredView(fileIndex, view))
+            part = &(m_parts[fileIndex] = view);
+    }
+    if (part)
+    {
+        sink(part->data, part->size);
+        return true;
+    }
+
+    return StreamEntry(m_zip, static_cast<mz_uint>(fileIndex), sink, m_scratch.chunk);
+}
+
+bool ArchiveSession::StreamPartConcurrently(const char* name, const std::function<bool(const char* data, size_t size)>& sink)
+{
+    if (!m_open || IsCancelled())
+        return false;
+
+    int fileIndex = LocatePart(name);
+    if (fileIndex < 0)
+        return false;
+
+    // Same as StreamPart, except that nothing is added to the cache or taken from the scratch buffers
+    auto it = m_parts.find(fileIndex);
+    PartBuffer view;
+    if (it != m_parts.end() || GetStoredView(fileIndex, view))
+    {
+        const PartBuffer& part = it != m_parts.end() ? it->second : view;
+        sink(part.data, part.size);
+        return true;
+    }
+
+    // A shallow copy shares the parsed directory but has an error code of its own
+    mz_zip_archive zip = *m_zip;
+    std::vector<char> chunk;
+    return StreamEntry(&zip, static_cast<mz_uint>(fileIndex), sink, chunk);
+}
+
+// Inflates the entry through zip into chunk and passes it to sink, or uses ParallelInflate if the entry qualifies
+bool ArchiveSession::StreamEntry(mz_zip_archive* zip, mz_uint fileIndex,
+                                 const std::function<bool(const char* data, size_t size)>& sink, std::vector<char>& chunk)
+{
+    // If a parallel inflate gives up halfway, the sequential one below skips what it has already delivered
+    mz_uint64 skip = 0;
+    if (m_parallelThreads > 1)
+    {
+        bool ok = false;
+        if (StreamPartParallel(fileIndex, sink, ok, skip))
+            return ok && !IsCancelled();
+    }
+
+    mz_uint flags = m_verifyCrc ? 0 : MZ_ZIP_FLAG_SKIP_CRC32_CHECK;
+    mz_zip_reader_extract_iter_state* iter = nullptr;
+    if (!GuardedRead([&] { iter = mz_zip_reader_extract_iter_new(zip, fileIndex, flags); }) || !iter)
+        return false;
+
+    try
+    {
+        chunk.resize(kStreamChunkSize);
+    }
+    catch (const std::bad_alloc&)
+    {
+        mz_zip_reader_extract_iter_free(iter);
+        return false;
+    }
+    bool stopped = false;
+    bool cancelled = false;
+    bool faulted = false;
+    while (true)
+    {
+        if (IsCancelled())
+        {
+            cancelled = true;
+            break;
+        }
+        size_t read = 0;
+        if (!GuardedRead([&] { read = mz_zip_reader_extract_iter_read(iter, chunk.data(), chunk.size()); }))
+        {
+            faulted = true;
+            break;
+        }
+        if (read == 0)
+            break;
+        size_t skipped = static_cast<size_t>(std::min<mz_uint64>(skip, read));
+        skip -= skipped;
+        if (read > skipped && !sink(chunk.data() + skipped, read - skipped))
+        {
+            stopped = true;
+            break;
+        }
+    }
+
+    // The iterator only verifies size and CRC once the whole part has been inflated
+    bool ok = mz_zip_reader_extract_iter_free(iter) != MZ_FALSE;
+    return !cancelled && !faulted && (ok || stopped);
+}
+
+void ArchiveSession::PrefetchParts(const std::vector<std::string>& names)
+{
+    if (!m_open || m_reader->Backend() != ARCHIVE_BACKEND_PLANNED || m_reader->Data())
+        return;
+
+    // Local header, name and extra field, then the data. The local extra field usually repeats the central
+    // one; the slack covers small differences, and a range that falls short is simply read on demand.
+    const mz_uint64 kLocalHeaderSlack = 256;
+    std::vector<std::pair<mz_uint64, mz_uint64>> ranges;
+    for (const std::string& name : names)
+    {
+        int fileIndex = LocatePart(name.c_str());
+        mz_zip_archive_file_stat file_stat;
+        if (fileIndex < 0 || m_parts.count(fileIndex) || !mz_zip_reader_file_stat(m_zip, fileIndex, &file_stat))
+            continue;
+        mz_uint64 headerSize = 30 + strlen(file_stat.m_filename) + kLocalHeaderSlack;
+        ranges.emplace_back(file_stat.m_local_header_ofs, headerSize + file_stat.m_comp_size);
+    }
+    m_reader->Planned().Prefetch(std::move(ranges));
+}
+
+void ArchiveSession::ForEachWordXmlPart(const std::function<bool(const char* name)>& fn)
+{
+    if (!m_open)
+        return;
+
+    // The main document holds nearly all revisions, so it goes first to let analyses that only need
+    // one hit stop before any of the other parts is inflated
+    int documentIndex = LocatePart("word/document.xml");
+    if (documentIndex >= 0 && !fn("word/document.xml"))
+        return;
+
+    mz_uint num_files = mz_zip_reader_get_num_files(m_zip);
+    for (mz_uint i = 0; i < num_files; ++i)
+    {
+        if (static_cast<int>(i) == documentIndex)
+            continue;
+
+        mz_zip_archive_file_stat file_stat;
+        if (!mz_zip_reader_file_stat(m_zip, i, &file_stat))
+            continue;
+
+        const char* fname = file_stat.m_filename;
+
+        // Process only XML files within the "word/" directory (e.g., document.xml, styles.xml, etc.)
+        if (strncmp(fname, "word/", 5) != 0 || strstr(fname, ".xml") == nullptr)
+            continue;
+
+        if (!fn(fname))
+            break;
+    }
+}
@@ -0,0 +1,297 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <map>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <cstdint>
+#include "miniz.h"
+
+// --- Mapped file ---
+// Read-only view of a whole file (file mapping on Windows, mmap elsewhere). Touching the view faults if the
+// file's storage goes away, so ArchiveSession reads it only under a guard against in-page errors.
+class MappedFile
+{
+public:
+    MappedFile() {}
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps the file; fails for missing or empty files and when no address space is left for the view.
+    bool Open(const char* path);
+    void Close();
+
+    const void* Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const void* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    void* m_mapping = nullptr;      // HANDLE of the file mapping object
+#endif
+};
+
+// --- Planned reader ---
+// Reads an archive in as few requests as possible, for network shares where every round trip costs
+// milliseconds. Small files are read whole. For larger ones the tail with the end of central directory
+// record and the central directory is fetched in one read, and the entries a request needs are fetched
+// up front with coalesced positional reads. Whatever was not planned is read on demand.
+class PlannedFile
+{
+public:
+    PlannedFile() {}
+    ~PlannedFile() { Close(); }
+
+    PlannedFile(const PlannedFile&) = delete;
+    PlannedFile& operator=(const PlannedFile&) = delete;
+
+    bool Open(const char* path);
+    void Close();
+
+    // The whole file if it was small enough to be read at once, nullptr otherwise
+    const void* Data() const { return m_whole.empty() ? nullptr : m_whole.data(); }
+    mz_uint64 Size() const { return m_size; }
+
+    // Fetches the byte ranges (offset, size) that are not held yet, merging ranges that lie close together
+    void Prefetch(std::vector<std::pair<mz_uint64, mz_uint64>> ranges);
+
+    // Forgets the prefetched ranges but keeps the tail with the central directory
+    void DropPrefetched() { m_ranges.resize(m_tailRanges); }
+
+    // mz_file_read_func for mz_zip_archive::m_pRead, with the PlannedFile as m_pIO_opaque
+    static size_t Read(void* opaque, mz_uint64 offset, void* buffer, size_t size);
+
+private:
+    struct Range
+    {
+        mz_uint64 offset;
+        std::vector<char> data;
+    };
+
+    bool ReadAt(mz_uint64 offset, void* buffer, size_t size);
+    void ReadTail();
+    const Range* FindRange(mz_uint64 offset, size_t size) const;
+
+    static const size_t kWholeFileLimit = 1024 * 1024;
+    static const size_t kTailSize = 64 * 1024;
+    static const mz_uint64 kCoalesceGap = 64 * 1024;       // Bytes read in vain rather than issuing another request
+    static const mz_uint64 kMaxRangeSize = 32 * 1024 * 1024;
+
+    mz_uint64 m_size = 0;
+    std::vector<char> m_whole;
+    std::vector<Range> m_ranges;
+    size_t m_tailRanges = 0;        // Leading entries of m_ranges read by ReadTail
+#ifdef _WIN32
+    void* m_file = nullptr;         // HANDLE, nullptr when closed
+#else
+    int m_file = -1;
+#endif
+};
+
+enum ArchiveBackend {
+    ARCHIVE_BACKEND_FILE,           // Buffered stdio reads through miniz
+    ARCHIVE_BACKEND_MAPPED,         // The archive is mapped and read in place; falls back to FILE if mapping fails
+    ARCHIVE_BACKEND_PLANNED,        // Reads go through a PlannedFile; falls back to FILE if the file cannot be opened
+};
+
+// MAPPED for files on fixed drives, PLANNED for files on network shares, FILE for removable and optical media
+ArchiveBackend PreferredArchiveBackend(const char* path);
+
+enum ArchiveIndex {
+    ARCHIVE_INDEX_SORTED,           // miniz sorts the central directory on open and binary-searches it by name
+    ARCHIVE_INDEX_HASHED,           // The central directory is left unsorted and hashed by name on the first lookup
+};
+
+// Size and last write time, which tell whether a pooled reader still shows the current file
+struct ArchiveIdentity
+{
+    mz_uint64 size = 0;
+    mz_uint64 lastWrite = 0;
+
+    bool operator==(const ArchiveIdentity& other) const { return size == other.size && lastWrite == other.lastWrite; }
+};
+
+bool GetArchiveIdentity(const char* path, ArchiveIdentity& identity);
+
+// --- Archive reader ---
+// An open archive: the file, miniz's parsed central directory and the name index. A reader outlives the
+// session that opened it in a small pool, so the next request for the same file skips the open, the search
+// for the end of central directory record and the directory parse.
+class ArchiveReader
+{
+public:
+    ArchiveReader(const char* path, ArchiveBackend backend, ArchiveIndex index);
+    ~ArchiveReader();
+
+    ArchiveReader(const ArchiveReader&) = delete;
+    ArchiveReader& operator=(const ArchiveReader&) = delete;
+
+    bool IsOpen() const { return m_open; }
+    mz_zip_archive* Zip() { return &m_zip; }
+
+    // The archive when it is held in memory as a whole (mapped, or read whole by the planned backend). A mapping
+    // is only read under the guard against in-page errors in archive.cpp.
+    const unsigned char* Data() const;
+    mz_uint64 Size() const;
+    PlannedFile& Planned() { return m_plannedFile; }
+
+    // Central directory index of the named entry, or -1. Safe to call from several threads at once.
+    int Locate(const char* name);
+
+    // True if entries can be read on several threads at once. The stdio fallback shares one file position.
+    bool SupportsConcurrentReads() const;
+
+    const std::string& Path() const { return m_path; }
+    ArchiveBackend Backend() const { return m_backend; }
+    ArchiveIndex Index() const { return m_index; }
+    const ArchiveIdentity& Identity() const { return m_identity; }
+    bool HasIdentity() const { return m_hasIdentity; }
+
+private:
+    void BuildNameIndex();
+
+    std::string m_path;
+    ArchiveBackend m_backend;
+    ArchiveIndex m_index;
+    ArchiveIdentity m_identity;
+    bool m_hasIdentity;
+    MappedFile m_mappedFile;        // Must outlive m_zip when the mapped backend is used
+    PlannedFile m_plannedFile;      // Likewise for the planned backend
+    mz_zip_archive m_zip;
+    bool m_open;
+    std::once_flag m_nameIndexOnce;
+    std::vector<uint64_t> m_nameIndex;      // Hash table of entry names for ARCHIVE_INDEX_HASHED
+};
+
+// Hands out a pooled reader for the file if one is still valid, or opens a new one
+std::unique_ptr<ArchiveReader> AcquireArchiveReader(const char* path, ArchiveBackend backend, ArchiveIndex index);
+
+// Puts the reader back into the pool, closing the least recently used or idle ones beyond the pool's limits
+void ReleaseArchiveReader(std::unique_ptr<ArchiveReader> reader);
+
+// Closes every pooled reader and waits for the thread that closes idle ones, e.g. before the plugin is unloaded
+void CloseArchiveReaders();
+
+// An extracted part. Points either into storage owned by the session or, for stored entries of an
+// archive held in memory, straight into the archive; valid as long as the session is.
+struct PartBuffer
+{
+    const char* data;
+    size_t size;
+    bool mapped;        // data lies in the read-only archive image (mapping or whole-file read)
+
+    bool Empty() const { return size == 0; }
+};
+
+// Buffers a session inflates into. They are handed from one session to the next on the same
+// thread, so in steady state a request reuses the memory of the previous one. Only the first
+// 4 MB of them are handed on; larger buffers are freed when the session ends.
+struct ArchiveScratch
+{
+    std::vector<std::vector<char>> parts;   // One buffer per inflated part
+    std::vector<char> readBuffer;           // Compressed input when the archive is not mapped
+    std::vector<char> chunk;                // Output buffer for StreamPart
+};
+
+// --- Archive session ---
+// Holds a .docx archive for the duration of one field computation so that every part is
+// inflated at most once, no matter how many analyzers ask for it. The archive itself comes
+// from the reader pool.
+class ArchiveSession
+{
+public:
+    explicit ArchiveSession(const char* zipPath, ArchiveBackend backend = ARCHIVE_BACKEND_MAPPED,
+                            ArchiveIndex index = ARCHIVE_INDEX_SORTED);
+    ~ArchiveSession();
+
+    ArchiveSession(const ArchiveSession&) = delete;
+    ArchiveSession& operator=(const ArchiveSession&) = delete;
+
+    bool IsOpen() const { return m_open; }
+
+    // True if the archive contains the named part (no data is inflated)
+    bool HasPart(const char* name);
+
+    // Uncompressed size of the part as recorded in the central directory (no data is inflated)
+    bool GetPartSize(const char* name, size_t& size);
+
+    // Returns the part, extracting it on first use. nullptr if the part is missing or cannot be inflated.
+    const PartBuffer* GetPart(const char* name);
+
+    // Hands the part over for destructive use such as parsing it in place. The buffer holds size + 1
+    // writable bytes and lives as long as the session. The part leaves the cache, so pointers returned
+    // for it earlier become invalid and asking for it again extracts it anew. nullptr if the part is
+    // missing or cannot be inflated.
+    char* TakePart(const char* name, size_t& size);
+
+    // Inflates the part in fixed-size chunks and passes each to sink until sink returns false. Parts that were
+    // already extracted with GetPart are passed in one piece. Returns false if the part is missing or its
+    // data is corrupt; chunks seen before the corruption was detected have already been delivered.
+    bool StreamPart(const char* name, const std::function<bool(const char* data, size_t size)>& sink);
+
+    // True if StreamPartConcurrently may be called from several threads at once
+    bool SupportsConcurrentReads() const { return m_open && m_reader->SupportsConcurrentReads(); }
+
+    // StreamPart for several threads at once, e.g. one per part. Parts the session already holds are passed from
+    // its cache; others are read without adding them to it. No other method may run while calls are in progress.
+    bool StreamPartConcurrently(const char* name, const std::function<bool(const char* data, size_t size)>& sink);
+
+    // Parts are checked against the CRC in the central directory as they are extracted, including stored entries
+    // handed out straight from memory. Callers that only read metadata from a file whose identity they already
+    // track can turn this off; sizes and the deflate stream are still checked.
+    void SetVerifyCrc(bool verify) { m_verifyCrc = verify; }
+
+    // StreamPart inflates deflated parts of at least minPartSize bytes with ParallelInflate on the given number
+    // of threads. Off by default; fewer than two threads leave it off.
+    void SetParallelInflate(unsigned threads, size_t minPartSize)
+    {
+        m_parallelThreads = threads;
+        m_parallelMinSize = minPartSize;
+    }
+
+    // Reads give up once *cancelled is set: GetPart and the StreamPart variants fail, and a part being streamed
+    // stops at the next chunk without its remaining data being delivered. nullptr, the default, never cancels.
+    void SetCancelFlag(const std::atomic<bool>* cancelled) { m_cancelled = cancelled; }
+
+    // Plans the reads for parts a request is going to need. Only the PLANNED backend reads anything here;
+    // parts that are missing are ignored.
+    void PrefetchParts(const std::vector<std::string>& names);
+
+    // Calls fn for every XML part in the "word/" directory until fn returns false, starting with word/document.xml.
+    void ForEachWordXmlPart(const std::function<bool(const char* name)>& fn);
+
+private:
+    int LocatePart(const char* name) { return m_reader->Locate(name); }
+    bool IsCancelled() const { return m_cancelled && m_cancelled->load(std::memory_order_relaxed); }
+    const PartBuffer* GetPart(mz_uint fileIndex);
+    bool GetStoredView(mz_uint fileIndex, PartBuffer& view);
+    bool GetDataOffset(const mz_zip_archive_file_stat& file_stat, mz_uint64& offset);
+    bool StreamPartParallel(mz_uint fileIndex, const std::function<bool(const char* data, size_t size)>& sink,
+                            bool& ok, mz_uint64& delivered);
+    bool InflatePart(mz_uint fileIndex, PartBuffer& part);
+    bool StreamEntry(mz_zip_archive* zip, mz_uint fileIndex, const std::function<bool(const char* data, size_t size)>& sink,
+                     std::vector<char>& chunk);
+    std::vector<char>* AcquireScratchBuffer(size_t size);
+
+    static const size_t kStreamChunkSize = 64 * 1024;
+    static const size_t kParallelSliceSize = 1024 * 1024;
+
+    std::unique_ptr<ArchiveReader> m_reader;
+    mz_zip_archive* m_zip;
+    bool m_open;
+    std::map<mz_uint, PartBuffer> m_parts;      // Extracted parts by central directory index
+    std::map<mz_uint, bool> m_failedParts;      // Parts that could not be inflated
+    ArchiveScratch m_scratch;                   // Taken over from the thread for the lifetime of the session
+    size_t m_scratchPartsInUse = 0;
+    bool m_verifyCrc = true;
+    unsigned m_parallelThreads = 0;
+    size_t m_parallelMinSize = 0;
+    const std::atomic<bool>* m_cancelled = nullptr;
+};
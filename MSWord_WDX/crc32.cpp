@@ -0,0 +1,180 @@
+// --- CRC-32 ---
+// Replaces the byte-at-a-time table loop in miniz (built with USE_EXTERNAL_MZCRC). Buffers of 64 bytes
+// or more are folded with carry-less multiplication when the CPU has PCLMULQDQ; everything else goes
+// through slice-by-16 tables. Both compute the zip (reflected 0xEDB88320) CRC.
+
+#include "miniz.h"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CRC32_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(CRC32_X86) && (defined(__GNUC__) || defined(__clang__))
+#define CRC32_TARGET_PCLMUL __attribute__((target("pclmul,sse2")))
+#else
+#define CRC32_TARGET_PCLMUL
+#endif
+
+namespace {
+
+struct CrcTables {
+    uint32_t t[16][256];    // t[k][b]: CRC of byte b followed by k zero bytes
+};
+
+CrcTables BuildCrcTables()
+{
+    CrcTables tables;
+    for (uint32_t b = 0; b < 256; ++b) {
+        uint32_t crc = b;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        tables.t[0][b] = crc;
+    }
+    for (int k = 1; k < 16; ++k) {
+        for (int b = 0; b < 256; ++b) {
+            uint32_t prev = tables.t[k - 1][b];
+            tables.t[k][b] = (prev >> 8) ^ tables.t[0][prev & 0xFF];
+        }
+    }
+    return tables;
+}
+
+const CrcTables g_crcTables = BuildCrcTables();
+
+inline uint32_t Load32(const unsigned char* p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+// crc is the running register, i.e. already inverted
+uint32_t Crc32Slice16(uint32_t crc, const unsigned char* p, size_t size)
+{
+    const uint32_t (*t)[256] = g_crcTables.t;
+    while (size >= 16) {
+        uint32_t a = Load32(p) ^ crc;
+        uint32_t b = Load32(p + 4);
+        uint32_t c = Load32(p + 8);
+        uint32_t d = Load32(p + 12);
+        crc = t[15][a & 0xFF] ^ t[14][(a >> 8) & 0xFF] ^ t[13][(a >> 16) & 0xFF] ^ t[12][a >> 24] ^
+              t[11][b & 0xFF] ^ t[10][(b >> 8) & 0xFF] ^ t[9][(b >> 16) & 0xFF] ^ t[8][b >> 24] ^
+              t[7][c & 0xFF] ^ t[6][(c >> 8) & 0xFF] ^ t[5][(c >> 16) & 0xFF] ^ t[4][c >> 24] ^
+              t[3][d & 0xFF] ^ t[2][(d >> 8) & 0xFF] ^ t[1][(d >> 16) & 0xFF] ^ t[0][d >> 24];
+        p += 16;
+        size -= 16;
+    }
+    while (size--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    return crc;
+}
+
+#ifdef CRC32_X86
+
+// Folds four 128-bit lanes across the buffer, then reduces them to 32 bits with a Barrett step. The constants
+// are powers of x modulo the bit-reflected polynomial, from Intel's "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ Instruction". size must be at least 64; the tail below a multiple of 16 is
+// left to the tables.
+CRC32_TARGET_PCLMUL uint32_t Crc32Pclmul(uint32_t crc, const unsigned char* p, size_t size)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5k0 = _mm_set_epi64x(0, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i low32 = _mm_setr_epi32(-1, 0, -1, 0);
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(crc)));
+    p += 64;
+    size -= 64;
+
+    while (size >= 64) {
+        __m128i y1 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i y2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i y3 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i y4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, y1), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, y2), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, y3), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, y4), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48)));
+        p += 64;
+        size -= 64;
+    }
+
+    // Four lanes into one, then any remaining 16-byte blocks
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x2);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x3);
+    x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), x4);
+    while (size >= 16) {
+        __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), _mm_clmulepi64_si128(x1, k3k4, 0x00)), next);
+        p += 16;
+        size -= 16;
+    }
+
+    // 128 to 64 bits
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), _mm_clmulepi64_si128(x1, k3k4, 0x10));
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 4), _mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5k0, 0x00));
+
+    // Barrett reduction to 32 bits
+    __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, low32), poly, 0x00);
+    x1 = _mm_xor_si128(x1, t);
+    crc = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+
+    return Crc32Slice16(crc, p, size);
+}
+
+bool CpuHasPclmul()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 1)) != 0;
+#else
+    return __builtin_cpu_supports("pclmul") != 0;
+#endif
+}
+
+#endif
+
+typedef uint32_t (*Crc32Fn)(uint32_t crc, const unsigned char* p, size_t size);
+
+Crc32Fn SelectFoldKernel()
+{
+#ifdef CRC32_X86
+    if (CpuHasPclmul())
+        return Crc32Pclmul;
+#endif
+    return nullptr;
+}
+
+const Crc32Fn g_foldKernel = SelectFoldKernel();
+
+} // namespace
+
+// Same contract as the miniz version: crc is a previous result (MZ_CRC32_INIT to start), and a null
+// ptr returns MZ_CRC32_INIT.
+mz_ulong mz_crc32(mz_ulong crc, const unsigned char* ptr, size_t buf_len)
+{
+    if (!ptr)
+        return MZ_CRC32_INIT;
+
+    uint32_t reg = static_cast<uint32_t>(crc) ^ 0xFFFFFFFFu;
+    if (g_foldKernel && buf_len >= 64)
+        reg = g_foldKernel(reg, ptr, buf_len);
+    else
+        reg = Crc32Slice16(reg, ptr, buf_len);
+    return reg ^ 0xFFFFFFFFu;
+}
@@ -173,6 +173,11 @@ extern "C" {
     }                                                                                                                               \
     MZ_MACRO_END
 
+static const mz_uint16 s_length_base[31] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258, 0, 0 };
+static const mz_uint8 s_length_extra[31] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0, 0, 0 };
+static const mz_uint16 s_dist_base[32] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577, 0, 0 };
+static const mz_uint8 s_dist_extra[32] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
 static void tinfl_clear_tree(tinfl_decompressor *r)
 {
     if (r->m_type == 0)
@@ -183,12 +188,343 @@ static void tinfl_clear_tree(tinfl_decompressor *r)
         MZ_CLEAR_ARR(r->m_tree_2);
 }
 
+#if TINFL_USE_FAST_LOOP
+/* Fast table entries. Bits 0-7 hold the number of bits the entry consumes. Literal/length entries then carry a kind flag, and */
+/* either one or two literal bytes in bits 16-31, or a length base in bits 16-24 with its extra bit count in bits 25-27. Distance */
+/* entries carry their extra bit count in bits 8-11 and their base in bits 16-31. A zero entry is a code longer than the table, */
+/* or one that is not in use; tinfl_decode_fast() then falls back to the regular lookup and tree. */
+#define TINFL_FAST_LITERAL 0x100
+#define TINFL_FAST_PAIR 0x200
+#define TINFL_FAST_LENGTH 0x400
+#define TINFL_FAST_END_OF_BLOCK 0x800
+#define TINFL_FAST_DIST 0x1000
+
+/* Every iteration starts with an 8-byte refill of the bit buffer and may write the longest match rounded up to 16 bytes */
+#define TINFL_FAST_IN_MARGIN 8
+#define TINFL_FAST_OUT_MARGIN (258 + 16)
+
+/* Largest multiple of each distance below 16 that fits in 16 bytes, by which a repeated pattern advances */
+static const mz_uint8 s_pattern_step[16] = { 0, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15 };
+
+static void tinfl_build_fast_table(mz_uint32 *pTable, mz_uint table_bits, const mz_uint8 *pCode_size, mz_uint num_syms, int is_dist)
+{
+    mz_uint i, total = 0, total_syms[16], next_code[17];
+    MZ_CLEAR_ARR(total_syms);
+    TINFL_MEMSET(pTable, 0, sizeof(mz_uint32) << table_bits);
+    for (i = 0; i < num_syms; ++i)
+        total_syms[pCode_size[i]]++;
+    next_code[0] = next_code[1] = 0;
+    for (i = 1; i <= 15; ++i)
+        next_code[i + 1] = (total = ((total + total_syms[i]) << 1));
+    for (i = 0; i < num_syms; ++i)
+    {
+        mz_uint code_size = pCode_size[i], cur_code, rev_code = 0, l;
+        mz_uint32 entry;
+        if (!code_size)
+            continue;
+        cur_code = next_code[code_size]++;
+        if (code_size > table_bits)
+            continue;
+        if (is_dist)
+            entry = (i < 30) ? (TINFL_FAST_DIST | ((mz_uint32)s_dist_extra[i] << 8) | ((mz_uint32)s_dist_base[i] << 16)) : 0;
+        else if (i < 256)
+            entry = TINFL_FAST_LITERAL | ((mz_uint32)i << 16);
+        else if (i == 256)
+            entry = TINFL_FAST_END_OF_BLOCK;
+        else if (i < 286)
+            entry = TINFL_FAST_LENGTH | ((mz_uint32)s_length_base[i - 257] << 16) | ((mz_uint32)s_length_extra[i - 257] << 25);
+        else
+            entry = 0;
+        if (!entry)
+            continue;
+        entry |= code_size;
+        for (l = code_size; l > 0; l--, cur_code >>= 1)
+            rev_code = (rev_code << 1) | (cur_code & 1);
+        for (; rev_code < (1U << table_bits); rev_code += (1U << code_size))
+            pTable[rev_code] = entry;
+    }
+    if (is_dist)
+        return;
+
+    /* Pair up literals whose codes fit in the index together. Walking down, the entry for the bits after the first code */
+    /* (at i >> len, a lower index) still holds a single symbol. */
+    for (i = 1U << table_bits; i-- > 0;)
+    {
+        mz_uint32 first = pTable[i], second;
+        if (!(first & TINFL_FAST_LITERAL))
+            continue;
+        second = pTable[i >> (first & 0xFF)];
+        if ((second & TINFL_FAST_LITERAL) && ((first & 0xFF) + (second & 0xFF)) <= table_bits)
+            pTable[i] = (first + (second & 0xFF)) | TINFL_FAST_PAIR | ((second >> 16) << 24);
+    }
+}
+
+static int tinfl_fast_tree_decode(const mz_int16 *pLookUp, const mz_int16 *pTree, tinfl_bit_buf_t bit_buf, mz_uint *pCode_len)
+{
+    int sym = pLookUp[bit_buf & (TINFL_FAST_LOOKUP_SIZE - 1)];
+    mz_uint code_len;
+    if (sym >= 0)
+    {
+        *pCode_len = sym >> 9;
+        return sym & 511;
+    }
+    code_len = TINFL_FAST_LOOKUP_BITS;
+    do
+    {
+        sym = pTree[~sym + ((bit_buf >> code_len++) & 1)];
+    } while (sym < 0);
+    *pCode_len = code_len;
+    return sym;
+}
+
+/* Decodes symbols of the current Huffman block while TINFL_FAST_IN_MARGIN input bytes and TINFL_FAST_OUT_MARGIN output bytes remain. */
+/* Returns 1 once the end of block code has been consumed, or 0 to let the regular decoder continue: near the end of either buffer, */
+/* or at a symbol it has to reject. Only whole symbols are consumed, so the regular decoder sees exactly the state it would have */
+/* reached on its own. Bits above num_bits may hold input bytes that are read again later; they are cleared on the way out. */
+static int tinfl_decode_fast(tinfl_decompressor *r, const mz_uint8 **ppIn_buf_cur, const mz_uint8 *pIn_buf_end, mz_uint8 *pOut_buf_start, mz_uint8 **ppOut_buf_cur, mz_uint8 *pOut_buf_end,
+                             size_t out_buf_size_mask, mz_uint32 decomp_flags, tinfl_bit_buf_t *pBit_buf, mz_uint32 *pNum_bits)
+{
+    const mz_uint8 *pIn_buf_cur = *ppIn_buf_cur, *pSym_in;
+    mz_uint8 *pOut_buf_cur = *ppOut_buf_cur;
+    tinfl_bit_buf_t bit_buf = *pBit_buf, sym_bit_buf;
+    mz_uint32 num_bits = *pNum_bits, sym_num_bits;
+    const mz_uint32 *pLitlen = r->m_fast_litlen, *pDist = r->m_fast_dist;
+    mz_uint32 entry = 0;
+    int end_of_block = 0, entry_ready = 0;
+
+    if (((pIn_buf_end - pIn_buf_cur) < TINFL_FAST_IN_MARGIN) || ((pOut_buf_end - pOut_buf_cur) < TINFL_FAST_OUT_MARGIN))
+        return 0;
+
+    if (!r->m_fast_tables_built)
+    {
+        tinfl_build_fast_table(r->m_fast_litlen, TINFL_FAST_LITLEN_BITS, r->m_code_size_0, r->m_table_sizes[0], 0);
+        tinfl_build_fast_table(r->m_fast_dist, TINFL_FAST_DIST_BITS, r->m_code_size_1, r->m_table_sizes[1], 1);
+        r->m_fast_tables_built = 1;
+    }
+
+    while ((pOut_buf_end - pOut_buf_cur) >= TINFL_FAST_OUT_MARGIN)
+    {
+        mz_uint32 length, dist, num_extra;
+        mz_uint code_len;
+        size_t dist_from_out_buf_start;
+        const mz_uint8 *pSrc;
+        mz_uint8 *pDst_end;
+
+        /* At least 56 bits, enough for a length and a distance with their extra bits. After a match this was already done */
+        /* before the copy, so that the table lookup overlaps it. */
+        if (!entry_ready)
+        {
+            if ((pIn_buf_end - pIn_buf_cur) < TINFL_FAST_IN_MARGIN)
+                break;
+            bit_buf |= MZ_READ_LE64(pIn_buf_cur) << num_bits;
+            pIn_buf_cur += (63 - num_bits) >> 3;
+            num_bits |= 56;
+            entry = pLitlen[bit_buf & ((1U << TINFL_FAST_LITLEN_BITS) - 1)];
+        }
+        entry_ready = 0;
+        pSym_in = pIn_buf_cur;
+        sym_bit_buf = bit_buf;
+        sym_num_bits = num_bits;
+
+        if (entry & TINFL_FAST_LITERAL)
+        {
+            /* Runs of literals are taken from one refill for as long as a full table index is left (at most 10 bytes) */
+            do
+            {
+                bit_buf >>= (entry & 0xFF);
+                num_bits -= (entry & 0xFF);
+                pOut_buf_cur[0] = (mz_uint8)(entry >> 16);
+                if (entry & TINFL_FAST_PAIR)
+                {
+                    pOut_buf_cur[1] = (mz_uint8)(entry >> 24);
+                    pOut_buf_cur += 2;
+                }
+                else
+                    pOut_buf_cur++;
+                if (num_bits < TINFL_FAST_LITLEN_BITS)
+                    break;
+                entry = pLitlen[bit_buf & ((1U << TINFL_FAST_LITLEN_BITS) - 1)];
+            } while (entry & TINFL_FAST_LITERAL);
+            continue;
+        }
+        if (entry & TINFL_FAST_LENGTH)
+        {
+            bit_buf >>= (entry & 0xFF);
+            num_bits -= (entry & 0xFF);
+            num_extra = (entry >> 25) & 7;
+            length = ((entry >> 16) & 511) + (mz_uint32)(bit_buf & ((1U << num_extra) - 1));
+        }
+        else if (entry & TINFL_FAST_END_OF_BLOCK)
+        {
+            bit_buf >>= (entry & 0xFF);
+            num_bits -= (entry & 0xFF);
+            end_of_block = 1;
+            break;
+        }
+        else
+        {
+            int sym = tinfl_fast_tree_decode(r->m_look_up[0], r->m_tree_0, bit_buf, &code_len);
+            if ((!code_len) || (sym >= 286))
+                goto reject;
+            bit_buf >>= code_len;
+            num_bits -= code_len;
+            if (sym < 256)
+            {
+                *pOut_buf_cur++ = (mz_uint8)sym;
+                continue;
+            }
+            if (sym == 256)
+            {
+                end_of_block = 1;
+                break;
+            }
+            num_extra = s_length_extra[sym - 257];
+            length = s_length_base[sym - 257] + (mz_uint32)(bit_buf & ((1U << num_extra) - 1));
+        }
+        bit_buf >>= num_extra;
+        num_bits -= num_extra;
+
+        entry = pDist[bit_buf & ((1U << TINFL_FAST_DIST_BITS) - 1)];
+        if (entry)
+        {
+            code_len = entry & 0xFF;
+            num_extra = (entry >> 8) & 15;
+            dist = entry >> 16;
+        }
+        else
+        {
+            int sym = tinfl_fast_tree_decode(r->m_look_up[1], r->m_tree_1, bit_buf, &code_len);
+            if ((!code_len) || (sym >= 30))
+                goto reject;
+            num_extra = s_dist_extra[sym];
+            dist = s_dist_base[sym];
+        }
+        bit_buf >>= code_len;
+        num_bits -= code_len;
+        dist += (mz_uint32)(bit_buf & ((1U << num_extra) - 1));
+        bit_buf >>= num_extra;
+        num_bits -= num_extra;
+
+        dist_from_out_buf_start = pOut_buf_cur - pOut_buf_start;
+        if (dist > dist_from_out_buf_start)
+        {
+            /* An error unless the match comes from the far end of a wrapping dictionary. The source then runs up to the end */
+            /* of the buffer, which lies ahead of the output, and may continue from its start. */
+            size_t head;
+            if (decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)
+                goto reject;
+            pSrc = pOut_buf_start + ((dist_from_out_buf_start - dist) & out_buf_size_mask);
+            head = MZ_MIN((size_t)length, (size_t)(pOut_buf_end - pSrc));
+            memmove(pOut_buf_cur, pSrc, head);
+            pOut_buf_cur += head;
+            for (pSrc = pOut_buf_start; head < length; ++head)
+                *pOut_buf_cur++ = *pSrc++;
+            continue;
+        }
+
+        if ((pIn_buf_end - pIn_buf_cur) >= TINFL_FAST_IN_MARGIN)
+        {
+            bit_buf |= MZ_READ_LE64(pIn_buf_cur) << num_bits;
+            pIn_buf_cur += (63 - num_bits) >> 3;
+            num_bits |= 56;
+            entry = pLitlen[bit_buf & ((1U << TINFL_FAST_LITLEN_BITS) - 1)];
+            entry_ready = 1;
+        }
+
+        pSrc = pOut_buf_cur - dist;
+        pDst_end = pOut_buf_cur + length;
+        if (dist >= 16)
+        {
+            /* Whole words; a non-wrapping buffer has no data past the output yet, so the last one may run over */
+            if (decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)
+            {
+                do
+                {
+                    TINFL_MEMCPY(pOut_buf_cur, pSrc, 16);
+                    pOut_buf_cur += 16;
+                    pSrc += 16;
+                } while (pOut_buf_cur < pDst_end);
+            }
+            else if (length >= 8)
+            {
+                /* The bytes past the output are still history here. The last word is copied again from length - 8, which */
+                /* rewrites a few bytes with the same values. */
+                while ((pDst_end - pOut_buf_cur) >= 8)
+                {
+                    TINFL_MEMCPY(pOut_buf_cur, pSrc, 8);
+                    pOut_buf_cur += 8;
+                    pSrc += 8;
+                }
+                TINFL_MEMCPY(pDst_end - 8, pDst_end - 8 - dist, 8);
+            }
+            else
+            {
+                /* 3 to 7 bytes from at least 16 back: two overlapping 4-byte copies, or three single bytes */
+                if (length >= 4)
+                {
+                    TINFL_MEMCPY(pOut_buf_cur, pSrc, 4);
+                    TINFL_MEMCPY(pDst_end - 4, pDst_end - 4 - dist, 4);
+                }
+                else
+                {
+                    pOut_buf_cur[0] = pSrc[0];
+                    pOut_buf_cur[1] = pSrc[1];
+                    pOut_buf_cur[2] = pSrc[2];
+                }
+            }
+        }
+        else if (dist == 1)
+            TINFL_MEMSET(pOut_buf_cur, pSrc[0], length);
+        else
+        {
+            /* A short period is repeated from a 16-byte pattern. Copying from the output itself would load bytes that */
+            /* were only just stored, which stalls on every word. The pattern starts over every s_pattern_step[dist] bytes. */
+            mz_uint8 pattern[16];
+            mz_uint32 i, step = s_pattern_step[dist];
+            for (i = 0; i < dist; ++i)
+                pattern[i] = pSrc[i];
+            for (; i < 16; ++i)
+                pattern[i] = pattern[i - dist];
+            if (decomp_flags & TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF)
+            {
+                do
+                {
+                    TINFL_MEMCPY(pOut_buf_cur, pattern, 16);
+                    pOut_buf_cur += step;
+                } while (pOut_buf_cur < pDst_end);
+            }
+            else
+            {
+                while ((pDst_end - pOut_buf_cur) >= 16)
+                {
+                    TINFL_MEMCPY(pOut_buf_cur, pattern, 16);
+                    pOut_buf_cur += step;
+                }
+                for (i = 0; pOut_buf_cur < pDst_end; ++i)
+                    *pOut_buf_cur++ = pattern[i];
+            }
+        }
+        pOut_buf_cur = pDst_end;
+    }
+    goto done;
+
+reject:
+    /* Leave the symbol to the regular decoder, which reports the error the same way it always has */
+    pIn_buf_cur = pSym_in;
+    bit_buf = sym_bit_buf;
+    num_bits = sym_num_bits;
+
+done:
+    *ppIn_buf_cur = pIn_buf_cur;
+    *ppOut_buf_cur = pOut_buf_cur;
+    *pBit_buf = bit_buf & ((((tinfl_bit_buf_t)1) << num_bits) - 1);
+    *pNum_bits = num_bits;
+    return end_of_block;
+}
+#endif
+
 tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_next, size_t *pIn_buf_size, mz_uint8 *pOut_buf_start, mz_uint8 *pOut_buf_next, size_t *pOut_buf_size, const mz_uint32 decomp_flags)
 {
-    static const mz_uint16 s_length_base[31] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258, 0, 0 };
-    static const mz_uint8 s_length_extra[31] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0, 0, 0 };
-    static const mz_uint16 s_dist_base[32] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577, 0, 0 };
-    static const mz_uint8 s_dist_extra[32] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
     static const mz_uint8 s_length_dezigzag[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
     static const mz_uint16 s_min_table_sizes[3] = { 257, 1, 4 };
 
@@ -323,6 +659,9 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
                 }
                 r->m_table_sizes[2] = 19;
             }
+#if TINFL_USE_FAST_LOOP
+            r->m_fast_tables_built = 0;
+#endif
             for (; (int)r->m_type >= 0; r->m_type--)
             {
                 int tree_next, tree_cur;
@@ -421,6 +760,10 @@ tinfl_status tinfl_decompress(tinfl_decompressor *r, const mz_uint8 *pIn_buf_nex
             for (;;)
             {
                 mz_uint8 *pSrc;
+#if TINFL_USE_FAST_LOOP
+                if (tinfl_decode_fast(r, &pIn_buf_cur, pIn_buf_end, pOut_buf_start, &pOut_buf_cur, pOut_buf_end, out_buf_size_mask, decomp_flags, &bit_buf, &num_bits))
+                    break;
+#endif
                 for (;;)
                 {
                     if (((pIn_buf_end - pIn_buf_cur) < 4) || ((pOut_buf_end - pOut_buf_cur) < 2))
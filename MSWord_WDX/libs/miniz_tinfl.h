@@ -126,6 +126,19 @@ typedef mz_uint32 tinfl_bit_buf_t;
 #define TINFL_BITBUF_SIZE (32)
 #endif
 
+/* Fast path for Huffman blocks: while plenty of input and output space remain, symbols are decoded through tables that resolve */
+/* up to two literals, or a length or distance with its base and extra bit count, in one lookup. Needs the 64-bit bit buffer. */
+#ifndef TINFL_USE_FAST_LOOP
+#if TINFL_USE_64BIT_BITBUF && MINIZ_LITTLE_ENDIAN
+#define TINFL_USE_FAST_LOOP 1
+#else
+#define TINFL_USE_FAST_LOOP 0
+#endif
+#endif
+
+#define TINFL_FAST_LITLEN_BITS 11
+#define TINFL_FAST_DIST_BITS 10
+
 struct tinfl_decompressor_tag
 {
     mz_uint32 m_state, m_num_bits, m_zhdr0, m_zhdr1, m_z_adler32, m_final, m_type, m_check_adler32, m_dist, m_counter, m_num_extra, m_table_sizes[TINFL_MAX_HUFF_TABLES];
@@ -139,6 +152,11 @@ struct tinfl_decompressor_tag
     mz_uint8 m_code_size_1[TINFL_MAX_HUFF_SYMBOLS_1];
     mz_uint8 m_code_size_2[TINFL_MAX_HUFF_SYMBOLS_2];
     mz_uint8 m_raw_header[4], m_len_codes[TINFL_MAX_HUFF_SYMBOLS_0 + TINFL_MAX_HUFF_SYMBOLS_1 + 137];
+#if TINFL_USE_FAST_LOOP
+    mz_uint32 m_fast_tables_built;
+    mz_uint32 m_fast_litlen[1 << TINFL_FAST_LITLEN_BITS];
+    mz_uint32 m_fast_dist[1 << TINFL_FAST_DIST_BITS];
+#endif
 };
 
 #ifdef __cplusplus
@@ -1516,7 +1516,7 @@ mz_bool mz_zip_reader_extract_to_mem_no_alloc1(mz_zip_archive *pZip, mz_uint fil
             return mz_zip_set_error(pZip, MZ_ZIP_FILE_READ_FAILED);
 
 #ifndef MINIZ_DISABLE_ZIP_READER_CRC32_CHECKS
-        if ((flags & MZ_ZIP_FLAG_COMPRESSED_DATA) == 0)
+        if ((flags & (MZ_ZIP_FLAG_COMPRESSED_DATA | MZ_ZIP_FLAG_SKIP_CRC32_CHECK)) == 0)
         {
             if (mz_crc32(MZ_CRC32_INIT, (const mz_uint8 *)pBuf, (size_t)file_stat.m_uncomp_size) != file_stat.m_crc32)
                 return mz_zip_set_error(pZip, MZ_ZIP_CRC_CHECK_FAILED);
@@ -1593,7 +1593,7 @@ mz_bool mz_zip_reader_extract_to_mem_no_alloc1(mz_zip_archive *pZip, mz_uint fil
             status = TINFL_STATUS_FAILED;
         }
 #ifndef MINIZ_DISABLE_ZIP_READER_CRC32_CHECKS
-        else if (mz_crc32(MZ_CRC32_INIT, (const mz_uint8 *)pBuf, (size_t)file_stat.m_uncomp_size) != file_stat.m_crc32)
+        else if (!(flags & MZ_ZIP_FLAG_SKIP_CRC32_CHECK) && mz_crc32(MZ_CRC32_INIT, (const mz_uint8 *)pBuf, (size_t)file_stat.m_uncomp_size) != file_stat.m_crc32)
         {
             mz_zip_set_error(pZip, MZ_ZIP_CRC_CHECK_FAILED);
             status = TINFL_STATUS_FAILED;
@@ -2061,7 +2061,7 @@ size_t mz_zip_reader_extract_iter_read(mz_zip_reader_extract_iter_state* pState,
 
 #ifndef MINIZ_DISABLE_ZIP_READER_CRC32_CHECKS
         /* Compute CRC if not returning compressed data only */
-        if (!(pState->flags & MZ_ZIP_FLAG_COMPRESSED_DATA))
+        if (!(pState->flags & (MZ_ZIP_FLAG_COMPRESSED_DATA | MZ_ZIP_FLAG_SKIP_CRC32_CHECK)))
             pState->file_crc32 = (mz_uint32)mz_crc32(pState->file_crc32, (const mz_uint8 *)pvBuf, copied_to_caller);
 #endif
 
@@ -2120,7 +2120,8 @@ size_t mz_zip_reader_extract_iter_read(mz_zip_reader_extract_iter_state* pState,
 
 #ifndef MINIZ_DISABLE_ZIP_READER_CRC32_CHECKS
                 /* Perform CRC */
-                pState->file_crc32 = (mz_uint32)mz_crc32(pState->file_crc32, pWrite_buf_cur, to_copy);
+                if (!(pState->flags & MZ_ZIP_FLAG_SKIP_CRC32_CHECK))
+                    pState->file_crc32 = (mz_uint32)mz_crc32(pState->file_crc32, pWrite_buf_cur, to_copy);
 #endif
 
                 /* Decrement data consumed from block */
@@ -2162,7 +2163,7 @@ mz_bool mz_zip_reader_extract_iter_free(mz_zip_reader_extract_iter_state* pState
             pState->status = TINFL_STATUS_FAILED;
         }
 #ifndef MINIZ_DISABLE_ZIP_READER_CRC32_CHECKS
-        else if (pState->file_crc32 != pState->file_stat.m_crc32)
+        else if (!(pState->flags & MZ_ZIP_FLAG_SKIP_CRC32_CHECK) && pState->file_crc32 != pState->file_stat.m_crc32)
         {
             mz_zip_set_error(pState->pZip, MZ_ZIP_DECOMPRESSION_FAILED);
             pState->status = TINFL_STATUS_FAILED;
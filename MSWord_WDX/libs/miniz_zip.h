@@ -101,7 +101,8 @@ typedef enum {
     MZ_ZIP_FLAG_ASCII_FILENAME = 0x10000,
     /*After adding a compressed file, seek back
     to local file header and set the correct sizes*/
-    MZ_ZIP_FLAG_WRITE_HEADER_SET_SIZE = 0x20000
+    MZ_ZIP_FLAG_WRITE_HEADER_SET_SIZE = 0x20000,
+    MZ_ZIP_FLAG_SKIP_CRC32_CHECK = 0x40000          /* extract without computing or checking the crc32 of the data; sizes are still checked */
 } mz_zip_flags;
 
 typedef enum {
@@ -32,6 +32,20 @@ distribution.
 #   include <cstdarg>
 #endif
 
+#ifdef TINYXML2_ARENA
+#   if defined(_WIN32)
+#       ifndef WIN32_LEAN_AND_MEAN
+#           define WIN32_LEAN_AND_MEAN
+#       endif
+#       ifndef NOMINMAX
+#           define NOMINMAX
+#       endif
+#       include <windows.h>
+#   elif defined(__linux__)
+#       include <sys/mman.h>
+#   endif
+#endif
+
 #if defined(_MSC_VER) && (_MSC_VER >= 1400 ) && (!defined WINCE)
 	// Microsoft Visual Studio, version 2005 and higher. Not WinCE.
 	/*int _snprintf_s(
@@ -854,6 +868,9 @@ const char* XMLNode::Value() const
 
 void XMLNode::SetValue( const char* str, bool staticMem )
 {
+#ifdef TINYXML2_ARENA
+    _document->_modified = true;
+#endif
     if ( staticMem ) {
         _value.SetInternedStr( str );
     }
@@ -1911,6 +1928,9 @@ float XMLElement::FloatText(float defaultValue) const
 
 XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
 {
+#ifdef TINYXML2_ARENA
+    _document->_modified = true;
+#endif
     XMLAttribute* last = 0;
     XMLAttribute* attrib = 0;
     for( attrib = _rootAttribute;
@@ -2180,6 +2200,114 @@ const char* XMLDocument::_errorNames[XML_ERROR_COUNT] = {
 };
 
 
+#ifdef TINYXML2_ARENA
+// Chunk header size, rounded so that allocations stay 16-byte aligned
+static const size_t ARENA_ALIGNMENT = 16;
+static const size_t ARENA_HEADER_SIZE = ( 3 * sizeof( size_t ) + ARENA_ALIGNMENT - 1 ) & ~( ARENA_ALIGNMENT - 1 );
+
+Arena::~Arena()
+{
+    while ( _chunks ) {
+        Chunk* next = _chunks->next;
+        DeleteChunk( _chunks );
+        _chunks = next;
+    }
+}
+
+
+void* Arena::Alloc( size_t size )
+{
+    size = ( size + ARENA_ALIGNMENT - 1 ) & ~( ARENA_ALIGNMENT - 1 );
+    if ( !_chunks || _chunks->size - _chunks->used < size ) {
+        const size_t chunkSize = size + ARENA_HEADER_SIZE > _nextChunkSize ? size + ARENA_HEADER_SIZE : _nextChunkSize;
+        Chunk* chunk = NewChunk( chunkSize );
+        if ( !chunk ) {
+            throw std::bad_alloc();
+        }
+        chunk->next = _chunks;
+        _chunks = chunk;
+        _nextChunkSize = chunk->size * 2;
+    }
+    void* result = reinterpret_cast<char*>( _chunks ) + _chunks->used;
+    _chunks->used += size;
+    return result;
+}
+
+
+void Arena::Reset()
+{
+    if ( !_chunks ) {
+        return;
+    }
+    if ( !_chunks->next && _chunks->size <= RETAINED_LIMIT ) {
+        _chunks->used = ARENA_HEADER_SIZE;
+        return;
+    }
+    size_t total = 0;
+    while ( _chunks ) {
+        Chunk* next = _chunks->next;
+        total += _chunks->size;
+        DeleteChunk( _chunks );
+        _chunks = next;
+    }
+    _nextChunkSize = total < RETAINED_LIMIT ? total : RETAINED_LIMIT;
+}
+
+
+Arena::Chunk* Arena::NewChunk( size_t minSize )
+{
+    size_t size = minSize;
+    void* memory = 0;
+#if defined(_WIN32)
+    // Large pages need the "Lock pages in memory" privilege; without it the call fails and normal pages are used
+    const SIZE_T largePage = GetLargePageMinimum();
+    if ( largePage && size >= largePage ) {
+        const size_t rounded = ( size + largePage - 1 ) & ~( largePage - 1 );
+        memory = VirtualAlloc( 0, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE );
+        if ( memory ) {
+            size = rounded;
+        }
+    }
+    if ( !memory ) {
+        memory = VirtualAlloc( 0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE );
+    }
+#elif defined(__linux__)
+    memory = mmap( 0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( memory == MAP_FAILED ) {
+        memory = 0;
+    }
+#   ifdef MADV_HUGEPAGE
+    else if ( size >= 2 * 1024 * 1024 ) {
+        madvise( memory, size, MADV_HUGEPAGE );
+    }
+#   endif
+#else
+    memory = malloc( size );
+#endif
+    if ( !memory ) {
+        return 0;
+    }
+    Chunk* chunk = static_cast<Chunk*>( memory );
+    chunk->next = 0;
+    chunk->size = size;
+    chunk->used = ARENA_HEADER_SIZE;
+    return chunk;
+}
+
+
+void Arena::DeleteChunk( Chunk* chunk )
+{
+#if defined(_WIN32)
+    VirtualFree( chunk, 0, MEM_RELEASE );
+#elif defined(__linux__)
+    munmap( chunk, chunk->size );
+#else
+    free( chunk );
+#endif
+}
+#endif
+
+
 XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
     XMLNode( 0 ),
     _writeBOM( false ),
@@ -2189,9 +2317,14 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
     _errorStr(),
     _errorLineNum( 0 ),
     _charBuffer( 0 ),
+    _ownsCharBuffer( true ),
     _parseCurLineNum( 0 ),
 	_parsingDepth(0),
     _unlinked(),
+#ifdef TINYXML2_ARENA
+    _arena(),
+    _modified( false ),
+#endif
     _elementPool(),
     _attributePool(),
     _textPool(),
@@ -2199,6 +2332,12 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespaceMode ) :
 {
     // avoid VC++ C4355 warning about 'this' in initializer list (C4355 is off by default in VS2012+)
     _document = this;
+#ifdef TINYXML2_ARENA
+    _elementPool.SetArena( &_arena );
+    _attributePool.SetArena( &_arena );
+    _textPool.SetArena( &_arena );
+    _commentPool.SetArena( &_arena );
+#endif
 }
 
 
@@ -2223,18 +2362,44 @@ void XMLDocument::MarkInUse(const XMLNode* const node)
 
 void XMLDocument::Clear()
 {
+#ifdef TINYXML2_ARENA
+    // A tree straight from the parser owns nothing outside the arena, so its nodes
+    // are dropped with the arena below instead of being visited one by one.
+    if ( _modified || !_unlinked.Empty() ) {
+        DeleteChildren();
+        while( _unlinked.Size()) {
+            DeleteNode(_unlinked[0]);	// Will remove from _unlinked as part of delete.
+        }
+    }
+    _firstChild = 0;
+    _lastChild = 0;
+    _modified = false;
+#else
     DeleteChildren();
 	while( _unlinked.Size()) {
 		DeleteNode(_unlinked[0]);	// Will remove from _unlinked as part of delete.
 	}
+#endif
 
 #ifdef TINYXML2_DEBUG
     const bool hadError = Error();
 #endif
     ClearError();
 
-    delete [] _charBuffer;
+#ifdef TINYXML2_ARENA
     _charBuffer = 0;
+    _elementPool.Clear();
+    _attributePool.Clear();
+    _textPool.Clear();
+    _commentPool.Clear();
+    _arena.Reset();
+#else
+    if ( _ownsCharBuffer ) {
+        delete [] _charBuffer;
+    }
+    _charBuffer = 0;
+#endif
+    _ownsCharBuffer = true;
 	_parsingDepth = 0;
 
 #if 0
@@ -2400,7 +2565,7 @@ XMLError XMLDocument::LoadFile( FILE* fp )
 
     const size_t size = static_cast<size_t>(filelength);
     TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[size+1];
+    _charBuffer = NewCharBuffer( size+1 );
     const size_t read = fread( _charBuffer, 1, size, fp );
     if ( read != size ) {
         SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
@@ -2456,10 +2621,36 @@ XMLError XMLDocument::Parse( const char* xml, size_t nBytes )
         nBytes = strlen( xml );
     }
     TIXMLASSERT( _charBuffer == 0 );
-    _charBuffer = new char[ nBytes+1 ];
+    _charBuffer = NewCharBuffer( nBytes+1 );
     memcpy( _charBuffer, xml, nBytes );
     _charBuffer[nBytes] = 0;
 
+    return ParseCharBuffer();
+}
+
+
+XMLError XMLDocument::ParseInPlace( char* xml, size_t nBytes )
+{
+    Clear();
+
+    if ( nBytes == 0 || !xml || !*xml ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+    if ( nBytes == static_cast<size_t>(-1) ) {
+        nBytes = strlen( xml );
+    }
+    TIXMLASSERT( _charBuffer == 0 );
+    _charBuffer = xml;
+    _ownsCharBuffer = false;
+    _charBuffer[nBytes] = 0;
+
+    return ParseCharBuffer();
+}
+
+
+XMLError XMLDocument::ParseCharBuffer()
+{
     Parse();
     if ( Error() ) {
         // clean up now essentially dangling memory.
@@ -2475,6 +2666,16 @@ XMLError XMLDocument::Parse( const char* xml, size_t nBytes )
 }
 
 
+char* XMLDocument::NewCharBuffer( size_t size )
+{
+#ifdef TINYXML2_ARENA
+    return static_cast<char*>( _arena.Alloc( size ) );
+#else
+    return new char[size];
+#endif
+}
+
+
 void XMLDocument::Print( XMLPrinter* streamer ) const
 {
     if ( streamer ) {
@@ -41,6 +41,9 @@ distribution.
 #   include <cstring>
 #endif
 #include <stdint.h>
+#ifdef TINYXML2_ARENA
+#   include <new>
+#endif
 
 /*
 	gcc:
@@ -336,6 +339,48 @@ public:
 };
 
 
+#ifdef TINYXML2_ARENA
+/*
+	Bump allocator behind the node pools and the character buffer of an
+	XMLDocument when TINYXML2_ARENA is defined. Chunks grow geometrically and
+	come from large pages where the OS grants them. Nothing is freed on its
+	own; Reset() releases everything at once.
+*/
+class Arena
+{
+public:
+    Arena() : _chunks( 0 ), _nextChunkSize( INITIAL_CHUNK_SIZE ) {}
+    ~Arena();
+
+    void* Alloc( size_t size );
+
+    // Releases all allocations. If the last document needed several chunks,
+    // the next one gets a single chunk of their combined size. No more than
+    // RETAINED_LIMIT is kept or planned for, so one huge document does not pin
+    // its memory for the life of the arena.
+    void Reset();
+
+    enum { INITIAL_CHUNK_SIZE = 64 * 1024 };
+    enum { RETAINED_LIMIT = 4 * 1024 * 1024 };
+
+private:
+    Arena( const Arena& ); // not supported
+    void operator=( const Arena& ); // not supported
+
+    struct Chunk {
+        Chunk*  next;
+        size_t  size;       // Including the header
+        size_t  used;
+    };
+    static Chunk* NewChunk( size_t minSize );
+    static void DeleteChunk( Chunk* chunk );
+
+    Chunk*  _chunks;        // Most recent first
+    size_t  _nextChunkSize;
+};
+#endif
+
+
 /*
 	Template child class to create pools of the correct type.
 */
@@ -348,7 +393,19 @@ public:
         MemPoolT< ITEM_SIZE >::Clear();
     }
 
+#ifdef TINYXML2_ARENA
+    // Blocks come from the arena and are released with it
+    void SetArena( Arena* arena ) {
+        _arena = arena;
+    }
+#endif
+
     void Clear() {
+#ifdef TINYXML2_ARENA
+        if ( _arena ) {
+            _blockPtrs.Clear();
+        }
+#endif
         // Delete the blocks.
         while( !_blockPtrs.Empty()) {
             Block* lastBlock = _blockPtrs.Pop();
@@ -371,7 +428,11 @@ public:
     virtual void* Alloc() override{
         if ( !_root ) {
             // Need a new block.
+#ifdef TINYXML2_ARENA
+            Block* block = _arena ? new ( _arena->Alloc( sizeof( Block ) ) ) Block : new Block;
+#else
             Block* block = new Block;
+#endif
             _blockPtrs.Push( block );
 
             Item* blockItems = block->items;
@@ -451,6 +512,9 @@ private:
     size_t _nAllocs;
     size_t _maxAllocs;
     size_t _nUntracked;
+#ifdef TINYXML2_ARENA
+    Arena* _arena = 0;
+#endif
 };
 
 
@@ -1752,6 +1816,18 @@ public:
     */
     XMLError Parse( const char* xml, size_t nBytes=static_cast<size_t>(-1) );
 
+    /**
+    	Parse an XML document inside a buffer owned by the caller,
+    	without copying it. The buffer is modified by the parse
+    	and must stay alive and untouched for as long as the
+    	document is in use; it is not freed by the document.
+
+    	'xml' must have room for nBytes+1 characters, as a null
+    	terminator is written at xml[nBytes]. If nBytes is not
+    	specified, 'xml' must already be null terminated.
+    */
+    XMLError ParseInPlace( char* xml, size_t nBytes=static_cast<size_t>(-1) );
+
     /**
     	Load an XML file from disk.
     	Returns XML_SUCCESS (0) on success, or
@@ -1941,6 +2017,7 @@ private:
     mutable StrPair	_errorStr;
     int             _errorLineNum;
     char*			_charBuffer;
+    bool            _ownsCharBuffer;    // False when parsing in a caller's buffer
     int				_parseCurLineNum;
 	int				_parsingDepth;
 	// Memory tracking does add some overhead.
@@ -1951,6 +2028,13 @@ private:
 	// and the performance is the same.
 	DynArray<XMLNode*, 10> _unlinked;
 
+#ifdef TINYXML2_ARENA
+    // Declared before the pools, which must not outlive it. _modified records whether
+    // the tree was edited after parsing, in which case nodes may own heap strings.
+    Arena           _arena;
+    bool            _modified;
+#endif
+
     MemPoolT< sizeof(XMLElement) >	 _elementPool;
     MemPoolT< sizeof(XMLAttribute) > _attributePool;
     MemPoolT< sizeof(XMLText) >		 _textPool;
@@ -1959,6 +2043,8 @@ private:
 	static const char* _errorNames[XML_ERROR_COUNT];
 
     void Parse();
+    XMLError ParseCharBuffer();
+    char* NewCharBuffer( size_t size );
 
     void SetError( XMLError error, int lineNum, const char* format, ... );
 
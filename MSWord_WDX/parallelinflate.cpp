@@ -0,0 +1,1002 @@
+#include "parallelinflate.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <system_error>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+
+const size_t kWindowSize = 32768;
+const size_t kOutputSlack = 258 + 16;       // Longest match plus the overshoot of word copies
+const size_t kMinChunkSize = 1024 * 1024;   // Compressed bytes per chunk
+const size_t kChunksPerThread = 4;
+const uint64_t kNoBlock = UINT64_MAX;
+const int kProbeSymbols = 64;               // Symbols decoded to confirm a block header found by searching
+const size_t kStopLookahead = 4;            // Chunks searched for the block that ends a chunk
+const size_t kInitialWideSize = 4 * kWindowSize;    // Marker mode usually ends within tens of KB
+const size_t kExpansionGuess = 4;           // Documents typically inflate to several times their compressed size
+
+const uint16_t kLengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115,
+                                   131, 163, 195, 227, 258 };
+const uint8_t kLengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const uint16_t kDistBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537,
+                                 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const uint8_t kDistExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const uint8_t kCodeLengthOrder[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+// Largest multiple of each distance below 16 that fits in 16 bytes, by which a repeated pattern advances
+const uint8_t kPatternStep[16] = { 0, 16, 16, 15, 16, 15, 12, 14, 16, 9, 10, 11, 12, 13, 14, 15 };
+
+// LSB-first bit reader that can start at any bit of a buffer held in memory. Bits past the end read as zero;
+// Overrun tells whether any of them were consumed. After Refill at least 56 bits are available.
+class BitReader
+{
+public:
+    BitReader(const unsigned char* data, size_t size, uint64_t bitOffset)
+        : m_data(data), m_size(size), m_pos(static_cast<size_t>(bitOffset / 8))
+    {
+        Refill();
+        Drop(static_cast<unsigned>(bitOffset % 8));
+    }
+
+    void Refill()
+    {
+        if (m_pos + 8 <= m_size) {
+            uint64_t word;
+            memcpy(&word, m_data + m_pos, 8);
+            m_buf |= word << m_count;
+            m_pos += (63 - m_count) >> 3;
+            m_count |= 56;
+        }
+        else {
+            for (; m_count <= 56; m_count += 8, ++m_pos) {
+                if (m_pos < m_size)
+                    m_buf |= uint64_t(m_data[m_pos]) << m_count;
+            }
+        }
+    }
+
+    unsigned Available() const { return m_count; }
+    unsigned Peek(unsigned count) const { return static_cast<unsigned>(m_buf & ((uint64_t(1) << count) - 1)); }
+    void Drop(unsigned count) { m_buf >>= count; m_count -= count; }
+    unsigned Bits(unsigned count)
+    {
+        unsigned value = Peek(count);
+        Drop(count);
+        return value;
+    }
+
+    void AlignToByte() { Drop(m_count & 7); }
+
+    // Skips n whole bytes at a byte boundary and returns them, or nullptr if the buffer ends first
+    const unsigned char* TakeBytes(size_t n)
+    {
+        uint64_t position = BitPosition() / 8;
+        if (position > m_size || n > m_size - position)
+            return nullptr;
+        m_pos = static_cast<size_t>(position) + n;
+        m_buf = 0;
+        m_count = 0;
+        return m_data + position;
+    }
+
+    uint64_t BitPosition() const { return uint64_t(m_pos) * 8 - m_count; }
+    bool Overrun() const { return BitPosition() > uint64_t(m_size) * 8; }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    size_t m_pos;               // Next byte to load
+    uint64_t m_buf = 0;
+    unsigned m_count = 0;       // Valid bits in m_buf
+};
+
+// Canonical Huffman decoder: codes up to kFastBits long are resolved with one table lookup, longer ones by
+// walking the code lengths.
+class HuffmanTable
+{
+public:
+    static const unsigned kFastBits = 10;
+
+    // False if the lengths do not form a prefix code. Like zlib, an incomplete code is only accepted when it is
+    // a single one-bit code, and not at all where complete is true.
+    bool Build(const uint8_t* lengths, int count, bool complete)
+    {
+        uint16_t counts[16] = {};
+        for (int i = 0; i < count; ++i)
+            counts[lengths[i]]++;
+
+        int left = 1;
+        int maxLength = 0;
+        for (int length = 1; length < 16; ++length) {
+            left = (left << 1) - counts[length];
+            if (left < 0)
+                return false;
+            if (counts[length])
+                maxLength = length;
+        }
+        if (left > 0 && maxLength != 0 && (complete || maxLength != 1))
+            return false;
+
+        uint16_t offsets[16];
+        offsets[1] = 0;
+        for (int length = 1; length < 15; ++length)
+            offsets[length + 1] = offsets[length] + counts[length];
+        for (int i = 0; i < count; ++i) {
+            if (lengths[i])
+                m_symbols[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+        }
+        memcpy(m_count, counts, sizeof(m_count));
+
+        memset(m_fast, 0, sizeof(m_fast));
+        ForEachCode(kFastBits, [&](int symbol, unsigned length, unsigned reversed) {
+            uint16_t entry = static_cast<uint16_t>(symbol << 4 | length);
+            for (unsigned slot = reversed; slot < (1u << kFastBits); slot += 1u << length)
+                m_fast[slot] = entry;
+        });
+        return true;
+    }
+
+    // Calls fn(symbol, length, code) for every code of at most maxLength bits, with the code bit-reversed the way it
+    // appears in the stream
+    template <typename Fn>
+    void ForEachCode(unsigned maxLength, Fn fn) const
+    {
+        unsigned code = 0;
+        int index = 0;
+        for (unsigned length = 1; length <= maxLength; ++length, code <<= 1) {
+            for (int n = 0; n < m_count[length]; ++n, ++code, ++index) {
+                unsigned reversed = 0;
+                for (unsigned bit = 0; bit < length; ++bit)
+                    reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+                fn(m_symbols[index], length, reversed);
+            }
+        }
+    }
+
+    // Next symbol, or -1 for a bit sequence that is not a code. The reader must hold at least 15 bits.
+    int Decode(BitReader& bits) const
+    {
+        uint16_t entry = m_fast[bits.Peek(kFastBits)];
+        if (entry) {
+            bits.Drop(entry & 15);
+            return entry >> 4;
+        }
+
+        unsigned peek = bits.Peek(15);
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (unsigned length = 1; length < 16; ++length) {
+            code |= (peek >> (length - 1)) & 1;
+            int count = m_count[length];
+            if (code - count < first) {
+                bits.Drop(length);
+                return m_symbols[index + (code - first)];
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+private:
+    uint16_t m_fast[1 << kFastBits];    // Symbol << 4 | code length, 0 where the code is longer or missing
+    uint16_t m_count[16];               // Number of codes of each length
+    uint16_t m_symbols[288];            // Symbols ordered by code
+};
+
+// Lookup tables for decoding a block's symbols, laid out like those of tinfl's fast loop. One lookup in litlen yields
+// one or two literals, or a match length's base and extra bit count; one in dist a distance's base and extra bit
+// count. Each entry holds the number of bits it consumes in bits 0-7. Literal/length entries then carry a kind flag,
+// and either literal bytes in bits 16-31 or a length base in bits 16-24 and its extra bit count in bits 25-27.
+// Distance entries carry their extra bit count in bits 8-11 and their base in bits 16-31. A zero entry is a code
+// longer than the table or not in use, and is left to HuffmanTable::Decode.
+struct DecodeTables
+{
+    static const unsigned kLitLenBits = 11;
+    static const unsigned kDistBits = 10;
+    static const uint32_t kLiteral = 0x100;
+    static const uint32_t kPair = 0x200;
+    static const uint32_t kLength = 0x400;
+    static const uint32_t kEndOfBlock = 0x800;
+
+    uint32_t litlen[1 << kLitLenBits];
+    uint32_t dist[1 << kDistBits];
+
+    void Build(const HuffmanTable& litlenCodes, const HuffmanTable& distCodes)
+    {
+        memset(litlen, 0, sizeof(litlen));
+        litlenCodes.ForEachCode(kLitLenBits, [&](int symbol, unsigned length, unsigned reversed) {
+            uint32_t entry;
+            if (symbol < 256)
+                entry = kLiteral | uint32_t(symbol) << 16;
+            else if (symbol == 256)
+                entry = kEndOfBlock;
+            else if (symbol < 286)
+                entry = kLength | uint32_t(kLengthBase[symbol - 257]) << 16 | uint32_t(kLengthExtra[symbol - 257]) << 25;
+            else
+                return;
+            for (unsigned slot = reversed; slot < (1u << kLitLenBits); slot += 1u << length)
+                litlen[slot] = entry | length;
+        });
+
+        // Pair up literals whose codes fit in the index together. Walking down, the entry for the bits after the first
+        // code (at i >> length, a lower index) still holds a single symbol.
+        for (unsigned i = 1u << kLitLenBits; i-- > 0;) {
+            uint32_t first = litlen[i];
+            if (!(first & kLiteral))
+                continue;
+            uint32_t second = litlen[i >> (first & 0xFF)];
+            if ((second & kLiteral) && (first & 0xFF) + (second & 0xFF) <= kLitLenBits)
+                litlen[i] = (first + (second & 0xFF)) | kPair | (second >> 16) << 24;
+        }
+
+        memset(dist, 0, sizeof(dist));
+        distCodes.ForEachCode(kDistBits, [&](int symbol, unsigned length, unsigned reversed) {
+            if (symbol >= 30)
+                return;
+            uint32_t entry = length | uint32_t(kDistExtra[symbol]) << 8 | uint32_t(kDistBase[symbol]) << 16;
+            for (unsigned slot = reversed; slot < (1u << kDistBits); slot += 1u << length)
+                dist[slot] = entry;
+        });
+    }
+};
+
+struct FixedTables
+{
+    HuffmanTable litlen;
+    HuffmanTable dist;
+    DecodeTables tables;
+
+    FixedTables()
+    {
+        uint8_t lengths[288];
+        memset(lengths, 8, 144);
+        memset(lengths + 144, 9, 112);
+        memset(lengths + 256, 7, 24);
+        memset(lengths + 280, 8, 8);
+        litlen.Build(lengths, 288, true);
+        memset(lengths, 5, 32);
+        dist.Build(lengths, 32, true);
+        tables.Build(litlen, dist);
+    }
+};
+
+const FixedTables g_fixedTables;
+
+// Reads the code tables of a dynamic Huffman block; the block header bits have been consumed
+bool ReadDynamicTables(BitReader& bits, HuffmanTable& litlen, HuffmanTable& dist)
+{
+    bits.Refill();
+    unsigned litlenCount = bits.Bits(5) + 257;
+    unsigned distCount = bits.Bits(5) + 1;
+    unsigned codeLengthCount = bits.Bits(4) + 4;
+    if (litlenCount > 286 || distCount > 30)
+        return false;
+
+    uint8_t codeLengthLengths[19] = {};
+    for (unsigned i = 0; i < codeLengthCount; ++i) {
+        bits.Refill();
+        codeLengthLengths[kCodeLengthOrder[i]] = static_cast<uint8_t>(bits.Bits(3));
+    }
+    HuffmanTable codeLengths;
+    if (!codeLengths.Build(codeLengthLengths, 19, true))
+        return false;
+
+    uint8_t lengths[286 + 30];
+    unsigned total = litlenCount + distCount;
+    for (unsigned n = 0; n < total;) {
+        bits.Refill();
+        int symbol = codeLengths.Decode(bits);
+        if (symbol < 0)
+            return false;
+        if (symbol < 16) {
+            lengths[n++] = static_cast<uint8_t>(symbol);
+            continue;
+        }
+        uint8_t value = 0;
+        unsigned repeat;
+        if (symbol == 16) {
+            if (n == 0)
+                return false;
+            value = lengths[n - 1];
+            repeat = 3 + bits.Bits(2);
+        }
+        else if (symbol == 17) {
+            repeat = 3 + bits.Bits(3);
+        }
+        else {
+            repeat = 11 + bits.Bits(7);
+        }
+        if (n + repeat > total)
+            return false;
+        memset(lengths + n, value, repeat);
+        n += repeat;
+    }
+
+    // A block without an end-of-block code could never end
+    if (lengths[256] == 0)
+        return false;
+    return litlen.Build(lengths, litlenCount, false) && dist.Build(lengths + litlenCount, distCount, false);
+}
+
+// Decodes the first symbols of a block without producing output, to weed out headers that only parse by chance
+bool ProbeBlock(BitReader& bits, const HuffmanTable& litlen, const HuffmanTable& dist)
+{
+    for (int i = 0; i < kProbeSymbols; ++i) {
+        bits.Refill();
+        int symbol = litlen.Decode(bits);
+        if (symbol < 256) {
+            if (symbol < 0)
+                return false;
+            continue;
+        }
+        if (symbol == 256)
+            return true;
+        if (symbol >= 286)
+            return false;
+        bits.Drop(kLengthExtra[symbol - 257]);
+        int distSymbol = dist.Decode(bits);
+        if (distSymbol < 0 || distSymbol >= 30)
+            return false;
+        bits.Drop(kDistExtra[distSymbol]);
+    }
+    return true;
+}
+
+int CountTrailingZeros(uint64_t mask)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<unsigned long>(mask)))
+        return static_cast<int>(index);
+    _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+    return static_cast<int>(index) + 32;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// Kraft sums of four 3-bit code lengths, in units of 2^-7
+struct KraftSums
+{
+    uint16_t sums[4096];
+
+    KraftSums()
+    {
+        for (unsigned i = 0; i < 4096; ++i) {
+            sums[i] = 0;
+            for (unsigned field = 0; field < 4; ++field) {
+                unsigned length = (i >> (3 * field)) & 7;
+                if (length)
+                    sums[i] += 128 >> length;
+            }
+        }
+    }
+};
+
+const KraftSums g_kraftSums;
+
+// True if a dynamic Huffman block with valid code tables starts at position
+bool IsBlockStart(const unsigned char* data, size_t size, uint64_t position, HuffmanTable& litlen, HuffmanTable& dist)
+{
+    // The code length code has to be complete, which is checked on its lengths before anything is built. They take
+    // at most 57 bits after the 17 bits of block header and counts.
+    uint64_t header;
+    memcpy(&header, data + position / 8, 8);
+    header >>= position % 8;
+    unsigned codeLengthCount = static_cast<unsigned>((header >> 13) & 15) + 4;
+    uint64_t lengths;
+    memcpy(&lengths, data + (position + 17) / 8, 8);
+    lengths >>= (position + 17) % 8;
+    lengths &= (uint64_t(1) << (3 * codeLengthCount)) - 1;
+    const uint16_t* sums = g_kraftSums.sums;
+    unsigned kraft = sums[lengths & 4095] + sums[(lengths >> 12) & 4095] + sums[(lengths >> 24) & 4095] +
+                     sums[(lengths >> 36) & 4095] + sums[lengths >> 48];
+    if (kraft != 128)
+        return false;
+
+    BitReader bits(data, size, position + 3);
+    return ReadDynamicTables(bits, litlen, dist) && ProbeBlock(bits, litlen, dist);
+}
+
+// First bit position in [from, to) where a dynamic Huffman block with valid code tables starts, or kNoBlock
+uint64_t FindBlockStart(const unsigned char* data, size_t size, uint64_t from, uint64_t to)
+{
+    HuffmanTable litlen;
+    HuffmanTable dist;
+    uint64_t end = std::min(to, uint64_t(size) * 8 - std::min<uint64_t>(uint64_t(size) * 8, 88));
+
+    // 32 positions at a time. Bit i of candidates is set if a header at base + i has BTYPE 2 (BFINAL may be
+    // either) and neither of its symbol counts is out of range, i.e. HLIT and HDIST are not 30 or 31.
+    for (uint64_t base = from; base < end; base += 32) {
+        uint64_t word;
+        memcpy(&word, data + base / 8, 8);
+        word >>= base % 8;
+        uint64_t candidates = (~word >> 1) & (word >> 2) &
+                              ~((word >> 4) & (word >> 5) & (word >> 6) & (word >> 7)) &
+                              ~((word >> 9) & (word >> 10) & (word >> 11) & (word >> 12));
+        candidates &= end - base < 32 ? (uint64_t(1) << (end - base)) - 1 : 0xFFFFFFFF;
+        for (; candidates != 0; candidates &= candidates - 1) {
+            uint64_t position = base + CountTrailingZeros(candidates);
+            if (IsBlockStart(data, size, position, litlen, dist))
+                return position;
+        }
+    }
+    return kNoBlock;
+}
+
+// The block start in each chunk's range, searched for once by whichever chunk needs it first
+class BlockStarts
+{
+public:
+    BlockStarts(const unsigned char* data, size_t size, size_t chunkSize, size_t chunkCount)
+        : m_data(data), m_size(size), m_chunkBits(uint64_t(chunkSize) * 8),
+          m_once(new std::once_flag[chunkCount]), m_starts(chunkCount, kNoBlock)
+    {
+    }
+
+    uint64_t Get(size_t chunk)
+    {
+        std::call_once(m_once[chunk], [&]() {
+            m_starts[chunk] = FindBlockStart(m_data, m_size, chunk * m_chunkBits, (chunk + 1) * m_chunkBits);
+        });
+        return m_starts[chunk];
+    }
+
+private:
+    const unsigned char* m_data;
+    size_t m_size;
+    uint64_t m_chunkBits;
+    std::unique_ptr<std::once_flag[]> m_once;
+    std::vector<uint64_t> m_starts;
+};
+
+struct ChunkResult
+{
+    bool empty = false;         // No block starts inside the chunk; the one before runs through it
+    bool decoded = false;       // Decoded up to stopBit, or through the final block
+    bool final = false;         // The last block decoded was the final one
+    uint64_t startBit = 0;
+    uint64_t stopBit = kNoBlock;
+    std::vector<uint16_t> wide;         // Output while it may hold markers: a byte, or 256 + offset into the previous 32 KB
+    std::vector<unsigned char> bytes;   // Output from the point where no more markers can appear
+    size_t wideSize = 0;                // Elements of wide in use
+    size_t historySize = 0;             // Leading bytes of bytes that repeat the end of wide
+    size_t byteSize = 0;                // Bytes of bytes in use
+};
+
+// Decodes blocks from a given bit position into a ChunkResult
+class ChunkDecoder
+{
+public:
+    ChunkDecoder(const unsigned char* data, size_t size, uint64_t startBit, bool streamStart, size_t chunkSize, ChunkResult& result)
+        : m_bits(data, size, startBit), m_result(result), m_wideMode(!streamStart), m_startBit(startBit),
+          m_chunkBits(uint64_t(chunkSize) * 8)
+    {
+        // Both outputs grow on demand
+        if (m_wideMode)
+            m_result.wide.resize(kInitialWideSize);
+        else
+            m_result.bytes.resize(kExpansionGuess * chunkSize);
+    }
+
+    // Decodes until a block would start at or after stopBit, or the final block is done. False on corrupt data,
+    // or when the last block ends past stopBit.
+    bool Run(uint64_t stopBit, const std::atomic<bool>& cancel)
+    {
+        while (true) {
+            uint64_t position = m_bits.BitPosition();
+            if (position >= stopBit)
+                return position == stopBit;
+            if (cancel.load(std::memory_order_relaxed))
+                return false;
+
+            m_bits.Refill();
+            bool final = m_bits.Bits(1) != 0;
+            unsigned type = m_bits.Bits(2);
+            bool ok = false;
+            if (type == 0)
+                ok = CopyStored();
+            else if (type == 1)
+                ok = DecodeHuffman(g_fixedTables.litlen, g_fixedTables.dist, g_fixedTables.tables);
+            else if (type == 2 && ReadDynamicTables(m_bits, m_litlen, m_dist)) {
+                m_tables.Build(m_litlen, m_dist);
+                ok = DecodeHuffman(m_litlen, m_dist, m_tables);
+            }
+            if (!ok || m_bits.Overrun())
+                return false;
+            if (final) {
+                m_result.final = true;
+                return true;
+            }
+        }
+    }
+
+private:
+    bool DecodeHuffman(const HuffmanTable& litlen, const HuffmanTable& dist, const DecodeTables& tables)
+    {
+        return m_wideMode ? DecodeWide(litlen, dist, tables) : DecodeBytes(litlen, dist, tables);
+    }
+
+    // Decodes the next symbol into a literal, a match (length > 0) or the end of the block. Short codes and up to two
+    // literals come from one table lookup; literals beyond the first are left in entry for the caller to store.
+    enum Symbol { SYMBOL_LITERALS, SYMBOL_MATCH, SYMBOL_END, SYMBOL_INVALID };
+
+    static Symbol DecodeSymbol(BitReader& bits, const HuffmanTable& litlen, const HuffmanTable& dist, const DecodeTables& tables,
+                               uint32_t& entry, size_t& length, size_t& distance)
+    {
+        entry = tables.litlen[bits.Peek(DecodeTables::kLitLenBits)];
+        if (entry & DecodeTables::kLiteral) {
+            bits.Drop(entry & 0xFF);
+            return SYMBOL_LITERALS;
+        }
+        if (entry & DecodeTables::kLength) {
+            bits.Drop(entry & 0xFF);
+            length = ((entry >> 16) & 511) + bits.Bits((entry >> 25) & 7);
+        }
+        else if (entry & DecodeTables::kEndOfBlock) {
+            bits.Drop(entry & 0xFF);
+            return SYMBOL_END;
+        }
+        else {
+            int symbol = litlen.Decode(bits);
+            if (symbol < 0)
+                return SYMBOL_INVALID;
+            if (symbol < 256) {
+                entry = DecodeTables::kLiteral | uint32_t(symbol) << 16;
+                return SYMBOL_LITERALS;
+            }
+            if (symbol == 256)
+                return SYMBOL_END;
+            symbol -= 257;
+            if (symbol >= 29)
+                return SYMBOL_INVALID;
+            length = kLengthBase[symbol] + bits.Bits(kLengthExtra[symbol]);
+        }
+
+        uint32_t distEntry = tables.dist[bits.Peek(DecodeTables::kDistBits)];
+        if (distEntry) {
+            bits.Drop(distEntry & 0xFF);
+            distance = (distEntry >> 16) + bits.Bits((distEntry >> 8) & 15);
+            return SYMBOL_MATCH;
+        }
+        int distSymbol = dist.Decode(bits);
+        if (distSymbol < 0 || distSymbol >= 30)
+            return SYMBOL_INVALID;
+        distance = kDistBase[distSymbol] + bits.Bits(kDistExtra[distSymbol]);
+        return SYMBOL_MATCH;
+    }
+
+    bool DecodeWide(const HuffmanTable& litlen, const HuffmanTable& dist, const DecodeTables& tables)
+    {
+        std::vector<uint16_t>& out = m_result.wide;
+        size_t pos = m_result.wideSize;
+        BitReader bits = m_bits;    // A local copy stays in registers across the output stores
+        bool ok = false;
+        while (true) {
+            if (pos >= m_nextMarkerCheck) {
+                size_t lastMarkerEnd = FindLastMarkerEnd(pos);
+                if (pos - lastMarkerEnd >= kWindowSize) {
+                    m_bits = bits;
+                    m_result.wideSize = pos;
+                    LeaveWideMode();
+                    return DecodeBytes(litlen, dist, tables);
+                }
+                m_nextMarkerCheck = lastMarkerEnd + kWindowSize;
+            }
+            if (out.size() - pos < kOutputSlack) {
+                if (bits.Overrun())
+                    break;
+                GrowOutput(out, pos, pos, bits.BitPosition());
+            }
+            uint16_t* p = out.data() + pos;
+
+            bits.Refill();
+            uint32_t entry;
+            size_t length = 0, distance = 0;
+            Symbol symbol = DecodeSymbol(bits, litlen, dist, tables, entry, length, distance);
+            if (symbol == SYMBOL_LITERALS) {
+                uint16_t* q = p;
+                while (true) {
+                    q[0] = static_cast<uint16_t>((entry >> 16) & 0xFF);
+                    if (entry & DecodeTables::kPair) {
+                        q[1] = static_cast<uint16_t>(entry >> 24);
+                        q += 2;
+                    }
+                    else {
+                        q++;
+                    }
+                    if (bits.Available() < DecodeTables::kLitLenBits)
+                        break;
+                    entry = tables.litlen[bits.Peek(DecodeTables::kLitLenBits)];
+                    if (!(entry & DecodeTables::kLiteral))
+                        break;
+                    bits.Drop(entry & 0xFF);
+                }
+                pos += q - p;
+                continue;
+            }
+            if (symbol != SYMBOL_MATCH) {
+                ok = symbol == SYMBOL_END;
+                break;
+            }
+
+            if (distance > pos) {
+                // The part of the match that lies before the chunk becomes markers
+                size_t before = std::min(length, distance - pos);
+                for (size_t i = 0; i < before; ++i)
+                    p[i] = static_cast<uint16_t>(256 + kWindowSize - (distance - pos - i));
+                for (size_t i = before; i < length; ++i)
+                    p[i] = p[i - distance];
+            }
+            else {
+                CopyWideMatch(p, distance, length);
+            }
+            pos += length;
+        }
+        m_bits = bits;
+        m_result.wideSize = pos;
+        return ok;
+    }
+
+    // CopyMatch for wide output; may write up to 15 elements past the match
+    static void CopyWideMatch(uint16_t* p, size_t distance, size_t length)
+    {
+        const uint16_t* src = p - distance;
+        uint16_t* end = p + length;
+        if (distance >= 8) {
+            do {
+                memcpy(p, src, 16);
+                p += 8;
+                src += 8;
+            } while (p < end);
+        }
+        else {
+            uint16_t pattern[16];
+            size_t i = 0;
+            for (; i < distance; ++i)
+                pattern[i] = src[i];
+            for (; i < 16; ++i)
+                pattern[i] = pattern[i - distance];
+            size_t step = kPatternStep[distance];
+            do {
+                memcpy(p, pattern, sizeof(pattern));
+                p += step;
+            } while (p < end);
+        }
+    }
+
+    // Position just past the last marker in the 32 KB of wide output before pos
+    size_t FindLastMarkerEnd(size_t pos) const
+    {
+        const uint16_t* out = m_result.wide.data();
+        size_t from = pos > kWindowSize ? pos - kWindowSize : 0;
+        for (size_t i = pos; i > from; --i) {
+            if (out[i - 1] >= 256)
+                return i;
+        }
+        return from;
+    }
+
+    // Copies a match within output that has kOutputSlack bytes of room past it. The copy may write up to 15 bytes past
+    // the match, which later output overwrites.
+    static void CopyMatch(unsigned char* p, size_t distance, size_t length)
+    {
+        const unsigned char* src = p - distance;
+        unsigned char* end = p + length;
+        if (distance >= 16) {
+            do {
+                memcpy(p, src, 16);
+                p += 16;
+                src += 16;
+            } while (p < end);
+        }
+        else if (distance == 1) {
+            memset(p, *src, length);
+        }
+        else {
+            // A short period is repeated from a pattern rather than read back from bytes that were only just stored
+            unsigned char pattern[16];
+            size_t i = 0;
+            for (; i < distance; ++i)
+                pattern[i] = src[i];
+            for (; i < 16; ++i)
+                pattern[i] = pattern[i - distance];
+            size_t step = kPatternStep[distance];
+            do {
+                memcpy(p, pattern, 16);
+                p += step;
+            } while (p < end);
+        }
+    }
+
+    bool DecodeBytes(const HuffmanTable& litlen, const HuffmanTable& dist, const DecodeTables& tables)
+    {
+        std::vector<unsigned char>& out = m_result.bytes;
+        size_t pos = m_result.byteSize;
+        BitReader bits = m_bits;
+        bool ok = false;
+        while (true) {
+            // Bits past the end read as zeros and still decode, so runaway output is caught whenever the buffer grows
+            if (out.size() - pos < kOutputSlack) {
+                if (bits.Overrun())
+                    break;
+                GrowOutput(out, pos, m_result.wideSize + pos - m_result.historySize, bits.BitPosition());
+            }
+            unsigned char* p = out.data() + pos;
+
+            bits.Refill();
+            uint32_t entry;
+            size_t length = 0, distance = 0;
+            Symbol symbol = DecodeSymbol(bits, litlen, dist, tables, entry, length, distance);
+            if (symbol == SYMBOL_LITERALS) {
+                // Runs of literals are taken from one refill for as long as a full table index is left
+                unsigned char* q = p;
+                while (true) {
+                    q[0] = static_cast<unsigned char>(entry >> 16);
+                    if (entry & DecodeTables::kPair) {
+                        q[1] = static_cast<unsigned char>(entry >> 24);
+                        q += 2;
+                    }
+                    else {
+                        q++;
+                    }
+                    if (bits.Available() < DecodeTables::kLitLenBits)
+                        break;
+                    entry = tables.litlen[bits.Peek(DecodeTables::kLitLenBits)];
+                    if (!(entry & DecodeTables::kLiteral))
+                        break;
+                    bits.Drop(entry & 0xFF);
+                }
+                pos += q - p;
+                continue;
+            }
+            if (symbol != SYMBOL_MATCH) {
+                ok = symbol == SYMBOL_END;
+                break;
+            }
+            if (distance > pos)
+                break;
+            CopyMatch(p, distance, length);
+            pos += length;
+        }
+        m_bits = bits;
+        m_result.byteSize = pos;
+        return ok;
+    }
+
+    bool CopyStored()
+    {
+        m_bits.AlignToByte();
+        m_bits.Refill();
+        unsigned length = m_bits.Bits(16);
+        if (m_bits.Bits(16) != (length ^ 0xFFFF))
+            return false;
+        const unsigned char* src = m_bits.TakeBytes(length);
+        if (!src)
+            return false;
+
+        if (m_wideMode) {
+            std::vector<uint16_t>& wide = m_result.wide;
+            if (wide.size() - m_result.wideSize < length)
+                wide.resize(std::max(wide.size() * 2, m_result.wideSize + length));
+            std::copy(src, src + length, wide.begin() + m_result.wideSize);
+            m_result.wideSize += length;
+            return true;
+        }
+        std::vector<unsigned char>& out = m_result.bytes;
+        if (out.size() - m_result.byteSize < length)
+            out.resize(std::max(out.size() * 2, m_result.byteSize + length));
+        memcpy(out.data() + m_result.byteSize, src, length);
+        m_result.byteSize += length;
+        return true;
+    }
+
+    // Grows output that has reached pos to hold the rest of the chunk, extrapolated from the produced output and the
+    // bits read for it, or by half once the chunk runs past that estimate. The size is reserved exactly, as resize
+    // alone may double the capacity.
+    template <typename T>
+    void GrowOutput(std::vector<T>& out, size_t pos, size_t produced, uint64_t bitPosition) const
+    {
+        uint64_t consumed = bitPosition - m_startBit;
+        size_t remaining = 0;
+        if (consumed > 0 && consumed < m_chunkBits)
+            remaining = size_t(double(produced) * double(m_chunkBits - consumed) / double(consumed));
+        size_t size = std::max(pos + remaining + remaining / 8, out.size() + out.size() / 2) + kOutputSlack;
+        out.reserve(size);
+        out.resize(size);
+    }
+
+    // The last 32 KB of wide output are plain bytes, so nothing after them can refer to the previous chunk.
+    // They are copied to the byte output as the history its back-references read from.
+    void LeaveWideMode()
+    {
+        const uint16_t* wideEnd = m_result.wide.data() + m_result.wideSize;
+        std::vector<unsigned char>& bytes = m_result.bytes;
+        GrowOutput(bytes, kWindowSize, m_result.wideSize, m_bits.BitPosition());
+        for (size_t i = 0; i < kWindowSize; ++i)
+            bytes[i] = static_cast<unsigned char>(wideEnd[i - kWindowSize]);
+        m_result.historySize = kWindowSize;
+        m_result.byteSize = kWindowSize;
+        m_wideMode = false;
+    }
+
+    BitReader m_bits;
+    ChunkResult& m_result;
+    bool m_wideMode;
+    uint64_t m_startBit;
+    uint64_t m_chunkBits;       // Compressed size of a chunk, to which output is extrapolated
+    size_t m_nextMarkerCheck = kWindowSize;     // Wide output position at which to look for markers again
+    HuffmanTable m_litlen;
+    HuffmanTable m_dist;
+    DecodeTables m_tables;
+};
+
+// Finds where the chunk's first block starts and where the next non-empty chunk's does, and decodes the blocks in
+// between. Every chunk searches only its own range for its start, so a chunk without one is run through by the
+// chunk before it. That chunk gives up looking for its end after a few chunks and decodes to the end of the stream.
+ChunkResult DecodeChunk(const unsigned char* data, size_t size, size_t chunkSize, size_t index, size_t chunkCount,
+                        BlockStarts& starts, const std::atomic<bool>& cancel)
+{
+    ChunkResult result;
+    if (index > 0) {
+        result.startBit = starts.Get(index);
+        if (result.startBit == kNoBlock) {
+            result.empty = true;
+            return result;
+        }
+    }
+    for (size_t next = index + 1; next < chunkCount && next <= index + kStopLookahead && result.stopBit == kNoBlock; ++next)
+        result.stopBit = starts.Get(next);
+
+    try {
+        ChunkDecoder decoder(data, size, result.startBit, index == 0, chunkSize, result);
+        result.decoded = decoder.Run(result.stopBit, cancel);
+    }
+    catch (const std::bad_alloc&) {
+        result.decoded = false;
+    }
+    return result;
+}
+
+// Maps wide output to bytes through lookup. Blocks without markers, most of them once the chunk has moved away from
+// its start, are narrowed without the lookup.
+void ResolveMarkers(const uint16_t* wide, size_t size, const unsigned char* lookup, unsigned char* out)
+{
+    const size_t kBlock = 16;
+    size_t i = 0;
+    for (; i + kBlock <= size; i += kBlock) {
+        uint16_t high = 0;
+        for (size_t k = 0; k < kBlock; ++k)
+            high |= wide[i + k];
+        if (high < 256) {
+            for (size_t k = 0; k < kBlock; ++k)
+                out[i + k] = static_cast<unsigned char>(wide[i + k]);
+        }
+        else {
+            for (size_t k = 0; k < kBlock; ++k)
+                out[i + k] = lookup[wide[i + k]];
+        }
+    }
+    for (; i < size; ++i)
+        out[i] = lookup[wide[i]];
+}
+
+// Keeps the last 32 KB passed to the sink for resolving markers
+void RememberOutput(std::vector<unsigned char>& window, const unsigned char* data, size_t size)
+{
+    if (size >= kWindowSize) {
+        window.assign(data + size - kWindowSize, data + size);
+        return;
+    }
+    size_t keep = std::min(window.size(), kWindowSize - size);
+    window.erase(window.begin(), window.end() - keep);
+    window.insert(window.end(), data, data + size);
+}
+
+} // namespace
+
+ParallelInflateStatus ParallelInflate(const unsigned char* data, size_t size, unsigned threads,
+                                      const std::function<bool(const char* data, size_t size)>& sink, uint64_t& delivered)
+{
+    delivered = 0;
+    if (threads < 1)
+        threads = 1;
+    size_t chunkSize = std::max(kMinChunkSize, size / (size_t(threads) * kChunksPerThread));
+    size_t chunkCount = (size + chunkSize - 1) / chunkSize;
+
+    std::atomic<bool> cancel(false);
+    BlockStarts starts(data, size, chunkSize, chunkCount);
+    std::deque<std::future<ChunkResult>> pending;
+    size_t launched = 0;
+    std::vector<unsigned char> window;
+    std::vector<unsigned char> resolved;
+    std::vector<unsigned char> lookup(256 + kWindowSize);
+    for (unsigned i = 0; i < 256; ++i)
+        lookup[i] = static_cast<unsigned char>(i);
+    uint64_t expectedStart = 0;
+
+    auto emit = [&](const unsigned char* piece, size_t pieceSize) {
+        if (pieceSize == 0)
+            return true;
+        delivered += pieceSize;
+        if (!sink(reinterpret_cast<const char*>(piece), pieceSize))
+            return false;
+        RememberOutput(window, piece, pieceSize);
+        return true;
+    };
+
+    // Chunks are decoded on up to threads workers and handed to the sink in order as they complete
+    ParallelInflateStatus status = PARALLEL_INFLATE_FAILED;
+    try {
+        while (true) {
+            while (launched < chunkCount && pending.size() < threads) {
+                size_t index = launched++;
+                pending.push_back(std::async(std::launch::async, [=, &starts, &cancel]() {
+                    return DecodeChunk(data, size, chunkSize, index, chunkCount, starts, cancel);
+                }));
+            }
+            if (pending.empty())
+                break;
+
+            ChunkResult result = pending.front().get();
+            pending.pop_front();
+            if (result.empty)
+                continue;
+            if (!result.decoded || result.startBit != expectedStart)
+                break;
+
+            // Markers point back into the 32 KB delivered before this chunk; they are resolved through a table
+            // that maps plain bytes to themselves. Right after the start of the stream fewer bytes are known.
+            size_t known = window.size();
+            for (size_t i = 0; i < known; ++i)
+                lookup[256 + kWindowSize - known + i] = window[i];
+            const uint16_t* wide = result.wide.data();
+            if (known < kWindowSize &&
+                std::any_of(wide, wide + result.wideSize, [=](uint16_t value) { return value >= 256 && value < 256 + kWindowSize - known; }))
+                break;
+            resolved.resize(result.wideSize);
+            ResolveMarkers(wide, result.wideSize, lookup.data(), resolved.data());
+
+            if (!emit(resolved.data(), resolved.size()) ||
+                !emit(result.bytes.data() + result.historySize, result.byteSize - result.historySize)) {
+                status = PARALLEL_INFLATE_STOPPED;
+                break;
+            }
+            if (result.final) {
+                status = PARALLEL_INFLATE_DONE;
+                break;
+            }
+            expectedStart = result.stopBit;
+        }
+    }
+    catch (const std::bad_alloc&) {
+        status = PARALLEL_INFLATE_FAILED;
+    }
+    catch (const std::system_error&) {
+        status = PARALLEL_INFLATE_FAILED;
+    }
+
+    // Chunks still in flight are abandoned
+    cancel = true;
+    for (std::future<ChunkResult>& future : pending)
+        future.wait();
+    return status;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+// --- Parallel inflate ---
+// Inflates one large raw deflate stream on several threads. The compressed data is cut into chunks, and every
+// chunk after the first is decoded from the first bit position in it that parses as the header of a dynamic
+// Huffman block. Back-references into the output of the previous chunk, which is not known yet, are kept as
+// markers until 32 KB have been produced without any; the markers are patched from the previous chunk's output
+// once it has been delivered. A chunk is only used if the chunk before it ended exactly where it started, so a
+// position that merely looked like a block header is never trusted.
+
+enum ParallelInflateStatus {
+    PARALLEL_INFLATE_DONE,          // The whole stream was delivered
+    PARALLEL_INFLATE_STOPPED,       // The sink returned false
+    PARALLEL_INFLATE_FAILED,        // The stream could not be split or decoded; see delivered
+};
+
+// Passes the output to sink in order, in pieces of any size. threads is the number of chunks decoded at once.
+// delivered is set to the number of bytes the sink has seen; after FAILED, a sequential inflater can take
+// over from there.
+ParallelInflateStatus ParallelInflate(const unsigned char* data, size_t size, unsigned threads,
+                                      const std::function<bool(const char* data, size_t size)>& sink, uint64_t& delivered);
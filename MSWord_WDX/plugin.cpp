@@ -1,17 +1,33 @@
 #include <windows.h>
 #include <string>
+#include <string_view>
 #include <cstring>
 #include <set>
+#include <bitset>
 #include <sstream>
 #include <functional>
 #include <cstddef>
+#include <cstdint>
 #include <cstdlib>
 #include <iomanip>
 #include <ctime>
 #include <cstdio>
 #include <vector>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <future>
+#include <memory>
+#include <thread>
+#include <system_error>
 #include "miniz.h"
 #include "tinyxml2.h"
+#include "archive.h"
+#include "xmlscanner.h"
+#include "simdscan.h"
 
 // Constants for Total Commander field types
 #define ft_nomorefields     0
@@ -29,6 +45,10 @@
 #define ft_fulltextw        12
 #define ft_fieldempty       -3
 #define ft_fileerror        -2
+#define ft_delayed          0
+
+// ContentGetValue flags
+#define CONTENT_DELAYIFSLOW 1
 
 typedef struct {
 WORD wYear;
@@ -42,6 +62,13 @@ WORD wMinute;
 WORD wSecond;
 } ttimeformat,*ptimeformat;
 
+typedef struct {
+int size;
+DWORD PluginInterfaceVersionLow;
+DWORD PluginInterfaceVersionHi;
+char DefaultIniName[MAX_PATH];
+} ContentDefaultParamStruct;
+
 // Field indices for plugin
 enum {
     // Document Properties (Core & App)
@@ -84,210 +111,9 @@ enum {
     FIELD_COUNT
 };
 
-// --- ZIP extraction function using miniz ---
-bool ExtractFileFromZip(const char* zipPath, const char* fileNameInZip, std::string& output)
-{
-    mz_zip_archive zip_archive;
-    memset(&zip_archive, 0, sizeof(zip_archive));
-
-    if (!mz_zip_reader_init_file(&zip_archive, zipPath, 0))
-        return false;
-
-    int fileIndex = mz_zip_reader_locate_file(&zip_archive, fileNameInZip, nullptr, 0);
-    if (fileIndex < 0)
-    {
-        mz_zip_reader_end(&zip_archive);
-        return false;
-    }
-
-    size_t uncompressed_size = 0;
-    void* p = mz_zip_reader_extract_file_to_heap(&zip_archive, fileNameInZip, &uncompressed_size, 0);
-    if (!p)
-    {
-        mz_zip_reader_end(&zip_archive);
-        return false;
-    }
-
-    output.assign(static_cast<char*>(p), uncompressed_size);
-    mz_free(p);
-    mz_zip_reader_end(&zip_archive);
-    return true;
-}
-
 // --- XML parsing helpers using tinyxml2 ---
-void ExtractAuthorsRecursive(tinyxml2::XMLElement* elem, std::set<std::string>& authors)
-{
-    if (!elem) return;
-
-    const char* name = elem->Name();
-    if (name)
-    {
-        // Add conditions for various formatting change tags
-        if (strcmp(name, "w:ins") == 0 ||
-            strcmp(name, "w:del") == 0 ||
-            strcmp(name, "w:rPrChange") == 0 ||
-            strcmp(name, "w:pPrChange") == 0 ||
-            strcmp(name, "w:sectPrChange") == 0 ||
-            strcmp(name, "w:tblPrChange") == 0 ||
-            strcmp(name, "w:tblGridChange") == 0 ||
-            strcmp(name, "w:trPrChange") == 0 ||
-            strcmp(name, "w:tcPrChange") == 0 ||
-            strcmp(name, "w:shd") == 0 ||
-            strcmp(name, "w:border") == 0 ||
-            strcmp(name, "w:jc") == 0 ||
-            strcmp(name, "w:ind") == 0 ||
-            strcmp(name, "w:spacing") == 0 ||
-            strcmp(name, "w:numPr") == 0 ||
-            strcmp(name, "w:tabs") == 0 ||
-            strcmp(name, "w:altChunk") == 0 ||
-            strcmp(name, "w:smartTagPr") == 0 ||
-            strcmp(name, "w:customXmlPr") == 0 ||
-            strcmp(name, "w:sdtPr") == 0 ||
-            strcmp(name, "w:style") == 0 ||
-            strcmp(name, "w:tblLook") == 0)
-        {
-            const char* author = elem->Attribute("w:author");
-            if (author)
-                authors.insert(author);
-            // Some formatting changes might have 'w:originalAuthor' as well
-            const char* originalAuthor = elem->Attribute("w:originalAuthor");
-            if (originalAuthor)
-                authors.insert(originalAuthor);
-        }
-    }
-
-    for (tinyxml2::XMLElement* child = elem->FirstChildElement(); child != nullptr; child = child->NextSiblingElement())
-    {
-        ExtractAuthorsRecursive(child, authors);
-    }
-}
-
-// Retrieves all unique authors from tracked changes across all XML files in the "word/" directory.
-std::set<std::string> GetTrackedChangeAuthorsFromAllXml(const char* zipPath)
-{
-    std::set<std::string> authors;
-
-    mz_zip_archive zip_archive;
-    memset(&zip_archive, 0, sizeof(zip_archive));
-
-    if (!mz_zip_reader_init_file(&zip_archive, zipPath, 0))
-        return authors;
-
-    mz_uint num_files = mz_zip_reader_get_num_files(&zip_archive);
-    for (mz_uint i = 0; i < num_files; ++i)
-    {
-        mz_zip_archive_file_stat file_stat;
-        if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat))
-            continue;
-
-        const char* fname = file_stat.m_filename;
-        if (!fname) continue;
-
-        if (strncmp(fname, "word/", 5) != 0 || strstr(fname, ".xml") == nullptr)
-            continue;
-
-        size_t uncompressed_size = 0;
-        void* p = mz_zip_reader_extract_to_heap(&zip_archive, i, &uncompressed_size, 0);
-        if (!p) continue;
-
-        std::string content(static_cast<char*>(p), uncompressed_size);
-        mz_free(p);
-
-        tinyxml2::XMLDocument doc;
-        if (doc.Parse(content.c_str()) != tinyxml2::XML_SUCCESS) continue;
-
-        tinyxml2::XMLElement* root = doc.RootElement();
-        if (!root) continue;
-
-        ExtractAuthorsRecursive(root, authors);
-    }
-
-    mz_zip_reader_end(&zip_archive);
-    return authors;
-}
-
-// Checks if the document XML content contains any type of tracked changes (insertions, deletions, or formatting changes).
-bool HasTrackedChanges(const char* zipPath)
-{
-    mz_zip_archive zip_archive;
-    memset(&zip_archive, 0, sizeof(zip_archive));
-
-    if (!mz_zip_reader_init_file(&zip_archive, zipPath, 0))
-        return false;
-
-    bool found = false;
-    mz_uint num_files = mz_zip_reader_get_num_files(&zip_archive);
-    for (mz_uint i = 0; i < num_files; ++i)
-    {
-        mz_zip_archive_file_stat file_stat;
-        if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat))
-            continue;
-
-        const char* fname = file_stat.m_filename;
-        if (!fname) continue;
-
-        // Process only XML files within the "word/" directory
-        if (strncmp(fname, "word/", 5) != 0 || strstr(fname, ".xml") == nullptr)
-            continue;
-
-        size_t uncompressed_size = 0;
-        void* p = mz_zip_reader_extract_to_heap(&zip_archive, i, &uncompressed_size, 0);
-        if (!p) continue;
-
-        std::string content(static_cast<char*>(p), uncompressed_size);
-        mz_free(p);
-
-        tinyxml2::XMLDocument doc;
-        if (doc.Parse(content.c_str()) != tinyxml2::XML_SUCCESS) continue;
-
-        tinyxml2::XMLElement* root = doc.RootElement();
-        if (!root) continue;
-
-        std::function<void(tinyxml2::XMLElement*)> check = [&](tinyxml2::XMLElement* elem)
-            {
-                if (!elem || found) return;
-
-                const char* name = elem->Name();
-                if (name)
-                {
-                    // ONLY check for explicit tracked change tags
-                    if (strcmp(name, "w:ins") == 0 ||
-                        strcmp(name, "w:del") == 0 ||
-                        strcmp(name, "w:moveFrom") == 0 ||
-                        strcmp(name, "w:rPrChange") == 0 ||     // Run properties (character formatting) change
-                        strcmp(name, "w:pPrChange") == 0 ||     // Paragraph properties change
-                        strcmp(name, "w:sectPrChange") == 0 ||  // Section properties change
-                        strcmp(name, "w:tblPrChange") == 0 ||   // Table properties change
-                        strcmp(name, "w:tblGridChange") == 0 || // Table grid properties change
-                        strcmp(name, "w:trPrChange") == 0 ||    // Table row properties change
-                        strcmp(name, "w:tcPrChange") == 0)      // Table cell properties change
-                    {
-                        found = true;
-                        return;
-                    }
-                }
-
-                for (tinyxml2::XMLElement* child = elem->FirstChildElement(); child != nullptr; child = child->NextSiblingElement())
-                    check(child);
-            };
-
-        check(root);
-        if (found) break; // Found changes, no need to check further files
-    }
-
-    mz_zip_reader_end(&zip_archive);
-    return found;
-}
-
-int CountComments(const std::string& xmlContent)
+int CountComments(tinyxml2::XMLElement* root)
 {
-    if (xmlContent.empty()) return 0;
-
-    tinyxml2::XMLDocument doc;
-    if (doc.Parse(xmlContent.c_str()) != tinyxml2::XML_SUCCESS)
-        return 0;
-
-    tinyxml2::XMLElement* root = doc.RootElement();
     if (!root) return 0;
 
     int count = 0;
@@ -298,18 +124,12 @@ int CountComments(const std::string& xmlContent)
     return count;
 }
 
-bool IsTrackChangesEnabled(const std::string& settingsXmlContent) {
-    tinyxml2::XMLDocument doc;
-    if (doc.Parse(settingsXmlContent.c_str()) != tinyxml2::XML_SUCCESS) {
-        return false;
-    }
-
-    tinyxml2::XMLElement* root = doc.RootElement();
+bool IsTrackChangesEnabled(tinyxml2::XMLElement* root) {
     if (!root) return false;
 
     for (tinyxml2::XMLElement* child = root->FirstChildElement(); child != nullptr; child = child->NextSiblingElement()) {
         const char* tag = child->Value();
-        if (tag && std::string(tag).find("trackRevisions") != std::string::npos) {
+        if (tag && std::string_view(tag).find("trackRevisions") != std::string::npos) {
             return true;
         }
     }
@@ -317,18 +137,12 @@ bool IsTrackChangesEnabled(const std::string& settingsXmlContent) {
     return false;
 }
 
-bool IsAutoUpdateStylesEnabled(const std::string& settingsXmlContent) {
-    tinyxml2::XMLDocument doc;
-    if (doc.Parse(settingsXmlContent.c_str()) != tinyxml2::XML_SUCCESS) {
-        return false;
-    }
-
-    tinyxml2::XMLElement* root = doc.RootElement();
+bool IsAutoUpdateStylesEnabled(tinyxml2::XMLElement* root) {
     if (!root) return false;
 
     for (tinyxml2::XMLElement* child = root->FirstChildElement(); child != nullptr; child = child->NextSiblingElement()) {
         const char* tag = child->Value();
-        if (tag && std::string(tag).find("linkStyles") != std::string::npos) {
+        if (tag && std::string_view(tag).find("linkStyles") != std::string::npos) {
             return true;
         }
     }
@@ -336,18 +150,12 @@ bool IsAutoUpdateStylesEnabled(const std::string& settingsXmlContent) {
     return false;
 }
 
-bool AreFilesAnonymised(const std::string& settingsXmlContent) {
-    tinyxml2::XMLDocument doc;
-    if (doc.Parse(settingsXmlContent.c_str()) != tinyxml2::XML_SUCCESS) {
-        return false;
-    }
-
-    tinyxml2::XMLElement* root = doc.RootElement();
+bool AreFilesAnonymised(tinyxml2::XMLElement* root) {
     if (!root) return false;
 
     for (tinyxml2::XMLElement* child = root->FirstChildElement(); child != nullptr; child = child->NextSiblingElement()) {
         const char* tag = child->Value();
-        if (tag && std::string(tag).find("removePersonalInformation") != std::string::npos) {
+        if (tag && std::string_view(tag).find("removePersonalInformation") != std::string::npos) {
             return true;
         }
     }
@@ -356,118 +164,50 @@ bool AreFilesAnonymised(const std::string& settingsXmlContent) {
 }
 
 
-bool HasHiddenTextInDocumentXml(const char* zipPath)
-{
-    mz_zip_archive zip_archive;
-    memset(&zip_archive, 0, sizeof(zip_archive));
-
-    if (!mz_zip_reader_init_file(&zip_archive, zipPath, 0))
-        return false;
-
-    const char* targetFile = "word/document.xml";
-    int fileIndex = mz_zip_reader_locate_file(&zip_archive, targetFile, nullptr, 0);
-    if (fileIndex < 0) {
-        mz_zip_reader_end(&zip_archive);
-        return false;
-    }
-
-    size_t uncompressed_size = 0;
-    void* p = mz_zip_reader_extract_to_heap(&zip_archive, fileIndex, &uncompressed_size, 0);
-    if (!p) {
-        mz_zip_reader_end(&zip_archive);
-        return false;
-    }
-
-    std::string xmlContent(static_cast<char*>(p), uncompressed_size);
-    mz_free(p);
-    mz_zip_reader_end(&zip_archive);
-
-    tinyxml2::XMLDocument doc;
-    tinyxml2::XMLError result = doc.Parse(xmlContent.c_str());
-    if (result != tinyxml2::XML_SUCCESS)
-        return false;
-
-    tinyxml2::XMLElement* root = doc.FirstChildElement("w:document");
-    if (!root) return false;
-
-    tinyxml2::XMLElement* body = root->FirstChildElement("w:body");
-    if (!body) return false;
-
-    for (tinyxml2::XMLElement* para = body->FirstChildElement("w:p"); para; para = para->NextSiblingElement("w:p")) {
-        for (tinyxml2::XMLElement* run = para->FirstChildElement("w:r"); run; run = run->NextSiblingElement("w:r")) {
-            tinyxml2::XMLElement* rPr = run->FirstChildElement("w:rPr");
-            if (!rPr) continue;
-
-            if (rPr->FirstChildElement("w:vanish")) {
-                return true;
-            }
-        }
-    }
-
-    return false;
-}
-
-bool IsCompatibilityModeEnabled(const std::string& settingsXmlContent)
+bool IsCompatibilityModeEnabled(tinyxml2::XMLElement* settings)
 {
-    tinyxml2::XMLDocument doc;
-    if (doc.Parse(settingsXmlContent.c_str()) != tinyxml2::XML_SUCCESS) {
-        return false;
-    }
-    tinyxml2::XMLElement* settings = doc.FirstChildElement("w:settings");
-    if (!settings) return false;
+    if (!settings || strcmp(settings->Name(), "w:settings") != 0) return false;
 
     tinyxml2::XMLElement* compat = settings->FirstChildElement("w:compat");
     if (!compat) {
         return false;
     }
 
-    tinyxml2::XMLElement* compatSetting = compat->FirstChildElement("w:compatSetting");
-    while (compatSetting) {
+    for (tinyxml2::XMLElement* compatSetting = compat->FirstChildElement("w:compatSetting"); compatSetting; compatSetting = compatSetting->NextSiblingElement("w:compatSetting")) {
         const char* nameAttr = compatSetting->Attribute("w:name");
         if (nameAttr && strcmp(nameAttr, "compatibilityMode") == 0) {
-            if (nameAttr && strcmp(nameAttr, "compatibilityMode") == 0) {
-                const char* valAttr = compatSetting->Attribute("w:val");
-                if (valAttr) {
-                    try {
-                        int compatVal = std::stoi(valAttr);
-                        // Word 2013 (val="15") and newer are considered "non-compatibility mode"
-                        // Word 2007 (val="12") and Word 2010 (val="14") are compatibility modes.
-                        // Word 2003 (val="11") would also be compatibility mode.
-                        return compatVal < 15;
-                    }
-                    catch (const std::invalid_argument&) {
-                        return false;
-                    }
-                    catch (const std::out_of_range&) {
-                        return false;
-                    }
+            const char* valAttr = compatSetting->Attribute("w:val");
+            if (valAttr) {
+                try {
+                    int compatVal = std::stoi(valAttr);
+                    // Word 2013 (val="15") and newer are considered "non-compatibility mode"
+                    // Word 2007 (val="12") and Word 2010 (val="14") are compatibility modes.
+                    // Word 2003 (val="11") would also be compatibility mode.
+                    return compatVal < 15;
+                }
+                catch (const std::invalid_argument&) {
+                    return false;
+                }
+                catch (const std::out_of_range&) {
+                    return false;
                 }
             }
-            compatSetting = compatSetting->NextSiblingElement("w:compatSetting");
         }
-        
     }
     return false;
 }
 
-std::string GetXmlStringValue(const std::string& xmlContent, const char* elementName) {
-    if (xmlContent.empty()) return "";
-    tinyxml2::XMLDocument doc;
-    if (doc.Parse(xmlContent.c_str()) != tinyxml2::XML_SUCCESS) return "";
-    tinyxml2::XMLElement* root = doc.RootElement();
-    if (!root) return "";
+// The text is a view into the parsed part and is only valid while its document is.
+std::string_view GetXmlStringValue(tinyxml2::XMLElement* root, const char* elementName) {
+    if (!root) return {};
     tinyxml2::XMLElement* element = root->FirstChildElement(elementName);
     if (element && element->GetText()) {
         return element->GetText();
     }
-    return "";
+    return {};
 }
 
-int GetXmlIntValue(const std::string& xmlContent, const char* elementName) {
-    if (xmlContent.empty()) return 0;
-    tinyxml2::XMLDocument doc;
-    if (doc.Parse(xmlContent.c_str()) != tinyxml2::XML_SUCCESS) return 0;
-    tinyxml2::XMLElement* root = doc.RootElement();
+int GetXmlIntValue(tinyxml2::XMLElement* root, const char* elementName) {
     if (!root) return 0;
     tinyxml2::XMLElement* element = root->FirstChildElement(elementName);
     if (element) {
@@ -479,22 +219,28 @@ int GetXmlIntValue(const std::string& xmlContent, const char* elementName) {
     return 0;
 }
 
-bool ParseIso8601ToFileTime(const std::string& iso8601_str, FILETIME* ft_out) {
-    if (iso8601_str.empty() || ft_out == nullptr) {
+bool ParseIso8601ToFileTime(std::string_view iso8601_view, FILETIME* ft_out) {
+    if (iso8601_view.empty() || ft_out == nullptr) {
         return false;
     }
 
+    // sscanf needs a terminated string; anything past the time zone is irrelevant
+    char iso8601_str[64];
+    size_t length = iso8601_view.size() < sizeof(iso8601_str) - 1 ? iso8601_view.size() : sizeof(iso8601_str) - 1;
+    memcpy(iso8601_str, iso8601_view.data(), length);
+    iso8601_str[length] = '\0';
+
     SYSTEMTIME st_utc = {};
 
     int year, month, day, hour = 0, minute = 0, second = 0;
     char tz_char_buffer[10];
     int result_count;
 
-    result_count = sscanf_s(iso8601_str.c_str(), "%d-%d-%dT%d:%d:%dZ", &year, &month, &day, &hour, &minute, &second);
+    result_count = sscanf_s(iso8601_str, "%d-%d-%dT%d:%d:%dZ", &year, &month, &day, &hour, &minute, &second);
     if (result_count == 6) {
     }
     else {
-        result_count = sscanf_s(iso8601_str.c_str(), "%d-%d-%dT%d:%d:%d%s", &year, &month, &day, &hour, &minute, &second, tz_char_buffer, (unsigned int)sizeof(tz_char_buffer));
+        result_count = sscanf_s(iso8601_str, "%d-%d-%dT%d:%d:%d%s", &year, &month, &day, &hour, &minute, &second, tz_char_buffer, (unsigned int)sizeof(tz_char_buffer));
         if (result_count == 7) {
             int offset_h = 0, offset_m = 0;
             char sign = tz_char_buffer[0];
@@ -510,9 +256,9 @@ bool ParseIso8601ToFileTime(const std::string& iso8601_str, FILETIME* ft_out) {
             }
         }
         else {
-            result_count = sscanf_s(iso8601_str.c_str(), "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second);
+            result_count = sscanf_s(iso8601_str, "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second);
             if (result_count != 6) {
-                result_count = sscanf_s(iso8601_str.c_str(), "%d-%d-%d", &year, &month, &day);
+                result_count = sscanf_s(iso8601_str, "%d-%d-%d", &year, &month, &day);
                 if (result_count != 3) {
                     return false;
                 }
@@ -611,114 +357,1361 @@ bool FormatSystemTimeToString(const FILETIME& ft_utc, int unitIndex, wchar_t* ou
     return true;
 }
 
+// --- WordprocessingML tag vocabulary ---
+// Every element name an analyzer reacts to is registered once in kWordTags. Scanned names are
+// looked up through a perfect hash built at compile time, so recognizing an element costs one
+// hash and one compare. New fields add their tags here instead of comparing names themselves.
+
+enum RevisionTag {
+    TAG_OTHER = 0,
+    TAG_INSERTION,          // w:ins
+    TAG_DELETION,           // w:del
+    TAG_MOVE_FROM,          // w:moveFrom
+    TAG_PROPERTY_CHANGE,    // w:*PrChange and w:tblGridChange
+    TAG_AUTHORED,           // Other elements whose w:author is collected
+};
+
+// Property sets whose changes are tracked. A change element (w:rPrChange, ...) normally holds the
+// old version of its property element (w:rPr, ...) as its first child.
+enum PropertyKind {
+    PROPERTY_NONE = -1,
+    PROPERTY_RUN = 0,
+    PROPERTY_PARAGRAPH,
+    PROPERTY_SECTION,
+    PROPERTY_TABLE,
+    PROPERTY_TABLE_GRID,
+    PROPERTY_TABLE_ROW,
+    PROPERTY_TABLE_CELL,
+    PROPERTY_KIND_COUNT
+};
+
+enum WordTag : unsigned char {
+    WORD_TAG_UNKNOWN = 0,
+    // Revisions
+    WORD_TAG_INS, WORD_TAG_DEL, WORD_TAG_MOVE_FROM,
+    // Property changes
+    WORD_TAG_RPR_CHANGE, WORD_TAG_PPR_CHANGE, WORD_TAG_SECTPR_CHANGE, WORD_TAG_TBLPR_CHANGE,
+    WORD_TAG_TBLGRID_CHANGE, WORD_TAG_TRPR_CHANGE, WORD_TAG_TCPR_CHANGE,
+    // Property elements
+    WORD_TAG_RPR, WORD_TAG_PPR, WORD_TAG_SECTPR, WORD_TAG_TBLPR, WORD_TAG_TBLGRID, WORD_TAG_TRPR, WORD_TAG_TCPR,
+    // Other elements whose author is collected
+    WORD_TAG_SHD, WORD_TAG_BORDER, WORD_TAG_JC, WORD_TAG_IND, WORD_TAG_SPACING, WORD_TAG_NUMPR, WORD_TAG_TABS,
+    WORD_TAG_ALT_CHUNK, WORD_TAG_SMART_TAG_PR, WORD_TAG_CUSTOM_XML_PR, WORD_TAG_SDTPR, WORD_TAG_STYLE, WORD_TAG_TBL_LOOK,
+    // Structure of the main document
+    WORD_TAG_DOCUMENT, WORD_TAG_BODY, WORD_TAG_P, WORD_TAG_R, WORD_TAG_VANISH,
+    WORD_TAG_COUNT
+};
+
+struct WordTagInfo {
+    WordTag tag;
+    const char* name;
+    RevisionTag revision;
+    PropertyKind changeOf;      // Property set this element records a change of
+    PropertyKind propertyOf;    // Property set this element holds
+};
+
+constexpr WordTagInfo kWordTags[WORD_TAG_COUNT] = {
+    { WORD_TAG_UNKNOWN,         "",                 TAG_OTHER,              PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_INS,             "w:ins",            TAG_INSERTION,          PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_DEL,             "w:del",            TAG_DELETION,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_MOVE_FROM,       "w:moveFrom",       TAG_MOVE_FROM,          PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_RPR_CHANGE,      "w:rPrChange",      TAG_PROPERTY_CHANGE,    PROPERTY_RUN,           PROPERTY_NONE },
+    { WORD_TAG_PPR_CHANGE,      "w:pPrChange",      TAG_PROPERTY_CHANGE,    PROPERTY_PARAGRAPH,     PROPERTY_NONE },
+    { WORD_TAG_SECTPR_CHANGE,   "w:sectPrChange",   TAG_PROPERTY_CHANGE,    PROPERTY_SECTION,       PROPERTY_NONE },
+    { WORD_TAG_TBLPR_CHANGE,    "w:tblPrChange",    TAG_PROPERTY_CHANGE,    PROPERTY_TABLE,         PROPERTY_NONE },
+    { WORD_TAG_TBLGRID_CHANGE,  "w:tblGridChange",  TAG_PROPERTY_CHANGE,    PROPERTY_TABLE_GRID,    PROPERTY_NONE },
+    { WORD_TAG_TRPR_CHANGE,     "w:trPrChange",     TAG_PROPERTY_CHANGE,    PROPERTY_TABLE_ROW,     PROPERTY_NONE },
+    { WORD_TAG_TCPR_CHANGE,     "w:tcPrChange",     TAG_PROPERTY_CHANGE,    PROPERTY_TABLE_CELL,    PROPERTY_NONE },
+    { WORD_TAG_RPR,             "w:rPr",            TAG_OTHER,              PROPERTY_NONE,          PROPERTY_RUN },
+    { WORD_TAG_PPR,             "w:pPr",            TAG_OTHER,              PROPERTY_NONE,          PROPERTY_PARAGRAPH },
+    { WORD_TAG_SECTPR,          "w:sectPr",         TAG_OTHER,              PROPERTY_NONE,          PROPERTY_SECTION },
+    { WORD_TAG_TBLPR,           "w:tblPr",          TAG_OTHER,              PROPERTY_NONE,          PROPERTY_TABLE },
+    { WORD_TAG_TBLGRID,         "w:tblGrid",        TAG_OTHER,              PROPERTY_NONE,          PROPERTY_TABLE_GRID },
+    { WORD_TAG_TRPR,            "w:trPr",           TAG_OTHER,              PROPERTY_NONE,          PROPERTY_TABLE_ROW },
+    { WORD_TAG_TCPR,            "w:tcPr",           TAG_OTHER,              PROPERTY_NONE,          PROPERTY_TABLE_CELL },
+    { WORD_TAG_SHD,             "w:shd",            TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_BORDER,          "w:border",         TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_JC,              "w:jc",             TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_IND,             "w:ind",            TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_SPACING,         "w:spacing",        TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_NUMPR,           "w:numPr",          TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_TABS,            "w:tabs",           TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_ALT_CHUNK,       "w:altChunk",       TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_SMART_TAG_PR,    "w:smartTagPr",     TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_CUSTOM_XML_PR,   "w:customXmlPr",    TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_SDTPR,           "w:sdtPr",          TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_STYLE,           "w:style",          TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_TBL_LOOK,        "w:tblLook",        TAG_AUTHORED,           PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_DOCUMENT,        "w:document",       TAG_OTHER,              PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_BODY,            "w:body",           TAG_OTHER,              PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_P,               "w:p",              TAG_OTHER,              PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_R,               "w:r",              TAG_OTHER,              PROPERTY_NONE,          PROPERTY_NONE },
+    { WORD_TAG_VANISH,          "w:vanish",         TAG_OTHER,              PROPERTY_NONE,          PROPERTY_NONE },
+};
+
+// Seed and table size were searched offline; the static_assert below catches a collision
+// introduced by a new tag, in which case another seed has to be found.
+constexpr uint32_t kWordTagHashSeed = 30;
+constexpr int kWordTagHashBits = 7;
+
+constexpr uint32_t HashTagName(const char* name, size_t length)
+{
+    uint32_t hash = kWordTagHashSeed;
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ static_cast<unsigned char>(name[i])) * 16777619u;
+    return hash >> (32 - kWordTagHashBits);
+}
+
+struct WordTagTable {
+    WordTag slots[1 << kWordTagHashBits];
+    bool valid;     // Entries are in enum order and no two share a slot
+};
+
+constexpr WordTagTable BuildWordTagTable()
+{
+    WordTagTable table = {};
+    table.valid = true;
+    for (int tag = WORD_TAG_UNKNOWN + 1; tag < WORD_TAG_COUNT; ++tag) {
+        const char* name = kWordTags[tag].name;
+        size_t length = 0;
+        while (name[length] != '\0')
+            length++;
+
+        uint32_t slot = HashTagName(name, length);
+        if (kWordTags[tag].tag != tag || table.slots[slot] != WORD_TAG_UNKNOWN)
+            table.valid = false;
+        table.slots[slot] = static_cast<WordTag>(tag);
+    }
+    return table;
+}
+
+constexpr WordTagTable kWordTagTable = BuildWordTagTable();
+static_assert(kWordTagTable.valid, "kWordTags is out of order or two tags share a hash slot");
+
+WordTag LookupWordTag(const XmlToken& name)
+{
+    WordTag tag = kWordTagTable.slots[HashTagName(name.data, name.length)];
+    return name.Equals(kWordTags[tag].name) ? tag : WORD_TAG_UNKNOWN;
+}
+
+// --- Story parts ---
+// The parts that can carry tracked changes: the main document and the headers, footers, notes and
+// comments it refers to. They are found through [Content_Types].xml and the main document's
+// relationships, so styles, themes, glossary and custom XML parts are never inflated.
+
+// Finds the main document among the Override entries of [Content_Types].xml
+class ContentTypesHandler : public XmlScanHandler
+{
+public:
+    std::string mainPart;
+
+    bool StartElement(const XmlToken& name, const XmlAttributes& attributes) override
+    {
+        std::string partName, contentType;
+        if (name.Equals("Override") && attributes.Find("PartName", partName) && attributes.Find("ContentType", contentType)) {
+            // Documents, templates and their macro-enabled variants all end in "main+xml"
+            std::string_view type(contentType);
+            bool wordprocessing = type.find("wordprocessingml") != std::string_view::npos || type.find("ms-word") != std::string_view::npos;
+            if (wordprocessing && type.size() >= 8 && type.substr(type.size() - 8) == "main+xml")
+                mainPart = partName[0] == '/' ? partName.substr(1) : partName;
+        }
+        return mainPart.empty();
+    }
+
+    bool EndElement(const XmlToken&) override { return true; }
+};
+
+// Collects the targets of the main document's relationships to story parts
+class StoryRelationshipsHandler : public XmlScanHandler
+{
+public:
+    std::vector<std::string> targets;
+
+    bool StartElement(const XmlToken& name, const XmlAttributes& attributes) override
+    {
+        static const char* const storyTypes[] = { "header", "footer", "footnotes", "endnotes", "comments" };
+
+        std::string type, target, mode;
+        if (!name.Equals("Relationship") || !attributes.Find("Type", type) || !attributes.Find("Target", target))
+            return true;
+        if (attributes.Find("TargetMode", mode) && mode == "External")
+            return true;
+
+        // Transitional and strict relationship types differ only before the last '/'
+        std::string_view kind = std::string_view(type).substr(type.rfind('/') + 1);
+        for (const char* storyType : storyTypes) {
+            if (kind == storyType) {
+                targets.push_back(target);
+                break;
+            }
+        }
+        return true;
+    }
+
+    bool EndElement(const XmlToken&) override { return true; }
+};
+
+// Resolves a relationship target against the directory of its source part ("word/" for "word/document.xml")
+std::string ResolvePartName(const std::string& sourcePart, const std::string& target)
+{
+    std::string path = target[0] == '/' ? target.substr(1) : sourcePart.substr(0, sourcePart.rfind('/') + 1) + target;
+
+    std::vector<std::string> segments;
+    size_t start = 0;
+    while (start <= path.size()) {
+        size_t slash = path.find('/', start);
+        if (slash == std::string::npos)
+            slash = path.size();
+        std::string segment = path.substr(start, slash - start);
+        if (segment == "..") {
+            if (!segments.empty())
+                segments.pop_back();
+        }
+        else if (!segment.empty() && segment != ".") {
+            segments.push_back(segment);
+        }
+        start = slash + 1;
+    }
+
+    std::string resolved;
+    for (const std::string& segment : segments)
+        resolved += (resolved.empty() ? "" : "/") + segment;
+    return resolved;
+}
+
+// Lists the story parts, main document first. Returns false if the package does not describe them, in which
+// case the caller has to fall back to every word/*.xml part.
+bool GetStoryParts(ArchiveSession& session, std::vector<std::string>& parts)
+{
+    const PartBuffer* contentTypes = session.GetPart("[Content_Types].xml");
+    if (!contentTypes)
+        return false;
+    ContentTypesHandler types;
+    ScanXml(contentTypes->data, contentTypes->size, types);
+    if (types.mainPart.empty())
+        return false;
+
+    // The relationships of a part live in _rels/<name>.rels next to it
+    const std::string& mainPart = types.mainPart;
+    size_t nameStart = mainPart.rfind('/') + 1;
+    std::string relsName = mainPart.substr(0, nameStart) + "_rels/" + mainPart.substr(nameStart) + ".rels";
+    const PartBuffer* rels = session.GetPart(relsName.c_str());
+    if (!rels)
+        return false;
+    StoryRelationshipsHandler relationships;
+    ScanXml(rels->data, rels->size, relationships);
+
+    parts.clear();
+    parts.push_back(mainPart);
+    for (const std::string& target : relationships.targets) {
+        std::string part = ResolvePartName(mainPart, target);
+        // Several relationships may point at the same part, which must still be counted once
+        bool seen = false;
+        for (const std::string& existing : parts)
+            seen = seen || _stricmp(existing.c_str(), part.c_str()) == 0;
+        if (!seen && !part.empty())
+            parts.push_back(part);
+    }
+    session.PrefetchParts(parts);
+    return true;
+}
+
+// --- WordprocessingML revision analyzer ---
+// A single traversal of the story parts listed by GetStoryParts collects everything the
+// tracked-change and hidden-text fields need, instead of one walk per field. Only packages
+// without usable content types and relationships fall back to every word/*.xml part.
+
+// First children of a change that get a slot of their own: any property element, or none at all
+const int FIRST_CHILD_NONE = PROPERTY_KIND_COUNT;
+const int FIRST_CHILD_SLOTS = PROPERTY_KIND_COUNT + 1;
+
 struct TrackedChangeCounts {
     int insertions = 0;
     int deletions = 0;
     int moves = 0;
     int formattingChanges = 0;
     int totalRevisions = 0;
-    std::set<std::string> uniqueFormattingChanges; // To count formatting changes like Word
+    // Word counts each distinct pair of change element and first child once
+    std::bitset<PROPERTY_KIND_COUNT * FIRST_CHILD_SLOTS> formattingChangesSeen;
+    std::set<std::string> otherFormattingChanges;   // Pairs whose first child is not a property element
+};
+
+// Sub-results the analyzer is asked for. Each bit is cleared as soon as its result is settled.
+enum {
+    WANT_PRESENCE = 1 << 0,     // any tracked change at all
+    WANT_COUNTS = 1 << 1,       // insertions, deletions, moves and formatting changes
+    WANT_AUTHORS = 1 << 2,      // authors of tracked changes
+    WANT_HIDDEN_TEXT = 1 << 3,  // w:vanish on a body run of the main document
+};
+
+struct WordXmlAnalysis {
+    bool hasTrackedChanges = false;
+    bool hasHiddenText = false;
+    TrackedChangeCounts counts;
+    std::set<std::string> authors;
 };
 
-void CountTrackedChangesRecursive(tinyxml2::XMLElement* elem, TrackedChangeCounts& counts) {
-    if (!elem) return;
+// Elements leading from the root of the main document to a hidden run: w:document/w:body/w:p/w:r/w:rPr/w:vanish
+const WordTag kHiddenTextPath[] = { WORD_TAG_DOCUMENT, WORD_TAG_BODY, WORD_TAG_P, WORD_TAG_R, WORD_TAG_RPR, WORD_TAG_VANISH };
+const int kHiddenTextPathLength = sizeof(kHiddenTextPath) / sizeof(kHiddenTextPath[0]);
+
+// Scan handler that feeds the elements of one part into a WordXmlAnalysis.
+class RevisionScanHandler : public XmlScanHandler
+{
+public:
+    RevisionScanHandler(bool isMainDocument, unsigned& wants, WordXmlAnalysis& analysis)
+        : m_wants(wants), m_analysis(analysis), m_hiddenTextPossible(isMainDocument) {}
 
-    const char* name = elem->Name();
-    if (name) {
-        if (strcmp(name, "w:ins") == 0) {
-            counts.insertions++;
+    bool StartElement(const XmlToken& name, const XmlAttributes& attributes) override
+    {
+        const WordTagInfo& info = kWordTags[LookupWordTag(name)];
+
+        // Hidden text needs every ancestor to be on kHiddenTextPath
+        if (m_hiddenTextPossible && m_depth == m_hiddenDepth && info.tag == kHiddenTextPath[m_hiddenDepth]) {
+            if (++m_hiddenDepth == kHiddenTextPathLength) {
+                m_analysis.hasHiddenText = true;
+                m_wants &= ~WANT_HIDDEN_TEXT;
+                m_hiddenDepth--;
+            }
         }
-        else if (strcmp(name, "w:del") == 0) {
-            counts.deletions++;
+        m_depth++;
+
+        // The first child of a property change tells which property was changed
+        if (m_pendingChange != WORD_TAG_UNKNOWN && m_depth == m_pendingChangeDepth + 1) {
+            if (info.propertyOf != PROPERTY_NONE)
+                AddFormattingChange(m_pendingChange, info.propertyOf);
+            else if (m_analysis.counts.otherFormattingChanges.insert(std::string(kWordTags[m_pendingChange].name) + ":" + name.ToString()).second)
+                m_analysis.counts.formattingChanges++;
+            m_pendingChange = WORD_TAG_UNKNOWN;
         }
-        else if (strcmp(name, "w:moveFrom") == 0) {
-            counts.moves++;
+
+        RevisionTag tag = info.revision;
+        if (tag != TAG_OTHER && tag != TAG_AUTHORED) {
+            m_analysis.hasTrackedChanges = true;
+            m_wants &= ~WANT_PRESENCE;
         }
-        else {
-            // Strictly check for explicit formatting change tracking tags
-            std::string change_id = name;
-            bool isFormattingChange = false;
-
-            if (strcmp(name, "w:rPrChange") == 0 ||     // Run properties (character formatting) change
-                strcmp(name, "w:pPrChange") == 0 ||     // Paragraph properties change
-                strcmp(name, "w:sectPrChange") == 0 ||  // Section properties change
-                strcmp(name, "w:tblPrChange") == 0 ||   // Table properties change
-                strcmp(name, "w:tblGridChange") == 0 || // Table grid properties change
-                strcmp(name, "w:trPrChange") == 0 ||    // Table row properties change
-                strcmp(name, "w:tcPrChange") == 0)      // Table cell properties change
-            {
-                isFormattingChange = true;
-                // For these property changes, include the type of property (e.g., w:b, w:color, w:pStyle)
-                // This helps uniquely identify the specific type of formatting change being tracked.
-                if (elem->FirstChildElement()) {
-                    change_id += ":" + std::string(elem->FirstChildElement()->Name());
-                }
-                else {
-                    // Fallback: if no child, just use the change tag itself as the unique ID.
-                    change_id += ":noChild";
-                }
-            }
-            // Removed direct check for w:style here, as it defines, not tracks, unless wrapped by *PrChange.
 
-            if (isFormattingChange) {
-                // Add to unique set to count each *distinct* tracked formatting change only once
-                if (counts.uniqueFormattingChanges.find(change_id) == counts.uniqueFormattingChanges.end()) {
-                    counts.uniqueFormattingChanges.insert(change_id);
-                    counts.formattingChanges++;
-                }
+        if ((m_wants & WANT_AUTHORS) && tag != TAG_OTHER && tag != TAG_MOVE_FROM) {
+            std::string author;
+            if (attributes.Find("w:author", author))
+                m_analysis.authors.insert(author);
+            // Some formatting changes might have 'w:originalAuthor' as well
+            if (attributes.Find("w:originalAuthor", author))
+                m_analysis.authors.insert(author);
+        }
+
+        if (m_wants & WANT_COUNTS) {
+            TrackedChangeCounts& counts = m_analysis.counts;
+            if (tag == TAG_INSERTION) {
+                counts.insertions++;
+            }
+            else if (tag == TAG_DELETION) {
+                counts.deletions++;
             }
+            else if (tag == TAG_MOVE_FROM) {
+                counts.moves++;
+            }
+            else if (tag == TAG_PROPERTY_CHANGE) {
+                m_pendingChange = info.tag;
+                m_pendingChangeDepth = m_depth;
+            }
+        }
+
+        return m_wants != 0;
+    }
+
+    bool EndElement(const XmlToken&) override
+    {
+        // Hidden runs only occur inside w:body, so the answer is settled once the body is closed
+        if (m_hiddenTextPossible && m_depth == 2 && m_hiddenDepth == 2) {
+            m_hiddenTextPossible = false;
+            m_wants &= ~WANT_HIDDEN_TEXT;
+        }
+
+        if (m_pendingChange != WORD_TAG_UNKNOWN && m_depth == m_pendingChangeDepth) {
+            // A change without children still counts once per change element
+            AddFormattingChange(m_pendingChange, FIRST_CHILD_NONE);
+            m_pendingChange = WORD_TAG_UNKNOWN;
+        }
+
+        m_depth--;
+        if (m_hiddenDepth > m_depth)
+            m_hiddenDepth = m_depth;
+        return m_wants != 0;
+    }
+
+private:
+    void AddFormattingChange(WordTag change, int firstChild)
+    {
+        // Count each *distinct* tracked formatting change only once
+        TrackedChangeCounts& counts = m_analysis.counts;
+        size_t slot = kWordTags[change].changeOf * FIRST_CHILD_SLOTS + firstChild;
+        if (!counts.formattingChangesSeen.test(slot)) {
+            counts.formattingChangesSeen.set(slot);
+            counts.formattingChanges++;
         }
     }
 
-    for (tinyxml2::XMLElement* child = elem->FirstChildElement(); child != nullptr; child = child->NextSiblingElement()) {
-        CountTrackedChangesRecursive(child, counts);
+    unsigned& m_wants;
+    WordXmlAnalysis& m_analysis;
+    bool m_hiddenTextPossible;
+    int m_depth = 0;                // Number of open elements
+    int m_hiddenDepth = 0;          // Number of open elements that match kHiddenTextPath
+    WordTag m_pendingChange = WORD_TAG_UNKNOWN;     // Change element still waiting for its first child
+    int m_pendingChangeDepth = 0;
+};
+
+// Parts up to this size are inflated whole so that a byte search can rule them out before scanning
+const size_t kPrefilterPartLimit = 256 * 1024;
+
+// Byte strings at least one of which a part must contain to contribute to the wanted results.
+// Most parts (styles, numbering, theme, font table) contain none of them.
+PatternSet RevisionCandidatePatterns(unsigned wants)
+{
+    PatternSet patterns;
+    if (wants & (WANT_PRESENCE | WANT_COUNTS)) {
+        patterns.Add("<w:ins");
+        patterns.Add("<w:del");
+        patterns.Add("<w:moveFrom");
+        patterns.Add("Change");     // w:rPrChange, w:tblGridChange and the other property changes
     }
+    if (wants & WANT_AUTHORS) {
+        patterns.Add("w:author");
+        patterns.Add("w:originalAuthor");
+    }
+    if (wants & WANT_HIDDEN_TEXT)
+        patterns.Add("<w:vanish");
+    return patterns;
 }
 
-TrackedChangeCounts GetTrackedChangeCounts(const char* zipPath) {
-    TrackedChangeCounts counts;
-    mz_zip_archive zip_archive;
-    memset(&zip_archive, 0, sizeof(zip_archive));
+// Runs one part through the revision scanner. Small parts are first checked for candidate tags and skipped
+// without scanning if they have none; larger ones are streamed and never held in memory as a whole.
+void AnalyzeWordXmlPart(ArchiveSession& session, const char* name, bool isMainDocument, unsigned& wants, WordXmlAnalysis& analysis)
+{
+    // Hidden text is only looked for in the main document, and is settled once that part has been seen
+    unsigned deferred = isMainDocument ? 0 : (wants & WANT_HIDDEN_TEXT);
+    unsigned partWants = wants & ~deferred;
+    if (partWants != 0) {
+        size_t partSize = 0;
+        const PartBuffer* part = nullptr;
+        if (session.GetPartSize(name, partSize) && partSize <= kPrefilterPartLimit)
+            part = session.GetPart(name);
+
+        RevisionScanHandler handler(isMainDocument, partWants, analysis);
+        if (part) {
+            if (RevisionCandidatePatterns(partWants).FoundIn(part->data, part->size))
+                ScanXml(part->data, part->size, handler);
+        }
+        else {
+            XmlScanner scanner(handler);
+            if (session.StreamPart(name, [&](const char* data, size_t size) { return scanner.Feed(data, size) == XML_SCAN_OK; }))
+                scanner.Finish();
+        }
+    }
+    wants = (partWants & ~WANT_HIDDEN_TEXT) | deferred;
+}
 
-    if (!mz_zip_reader_init_file(&zip_archive, zipPath, 0))
-        return counts;
+// Concurrent counterpart of AnalyzeWordXmlPart for the parts of one document being analyzed at once. Small parts
+// are collected into a buffer of their own instead of the session's cache. Every part gets a fresh analysis, so
+// wants is never narrowed by what earlier parts have settled.
+WordXmlAnalysis AnalyzeWordXmlPartConcurrently(ArchiveSession& session, const char* name, size_t partSize, bool isMainDocument, unsigned wants)
+{
+    WordXmlAnalysis analysis;
+    unsigned partWants = isMainDocument ? wants : (wants & ~WANT_HIDDEN_TEXT);
+    if (partWants == 0)
+        return analysis;
+
+    RevisionScanHandler handler(isMainDocument, partWants, analysis);
+    if (partSize <= kPrefilterPartLimit) {
+        std::string buffer;
+        buffer.reserve(partSize);
+        bool complete = session.StreamPartConcurrently(name, [&](const char* data, size_t size) {
+            buffer.append(data, size);
+            return true;
+        });
+        // A part that fails to inflate is scanned as far as it got, as when it is streamed
+        if (!complete || RevisionCandidatePatterns(partWants).FoundIn(buffer.data(), buffer.size()))
+            ScanXml(buffer.data(), buffer.size(), handler);
+    }
+    else {
+        XmlScanner scanner(handler);
+        if (session.StreamPartConcurrently(name, [&](const char* data, size_t size) { return scanner.Feed(data, size) == XML_SCAN_OK; }))
+            scanner.Finish();
+    }
+    return analysis;
+}
 
-    mz_uint num_files = mz_zip_reader_get_num_files(&zip_archive);
-    for (mz_uint i = 0; i < num_files; ++i)
-    {
-        mz_zip_archive_file_stat file_stat;
-        if (!mz_zip_reader_file_stat(&zip_archive, i, &file_stat))
-            continue;
+// Adds the results of one part to those of the document
+void MergeWordXmlAnalysis(WordXmlAnalysis& analysis, const WordXmlAnalysis& part)
+{
+    analysis.hasTrackedChanges = analysis.hasTrackedChanges || part.hasTrackedChanges;
+    analysis.hasHiddenText = analysis.hasHiddenText || part.hasHiddenText;
+
+    TrackedChangeCounts& counts = analysis.counts;
+    counts.insertions += part.counts.insertions;
+    counts.deletions += part.counts.deletions;
+    counts.moves += part.counts.moves;
+    // A formatting change seen in several parts is still only counted once
+    counts.formattingChangesSeen |= part.counts.formattingChangesSeen;
+    counts.otherFormattingChanges.insert(part.counts.otherFormattingChanges.begin(), part.counts.otherFormattingChanges.end());
+    counts.formattingChanges = static_cast<int>(counts.formattingChangesSeen.count() + counts.otherFormattingChanges.size());
+
+    analysis.authors.insert(part.authors.begin(), part.authors.end());
+}
 
-        const char* fname = file_stat.m_filename;
-        if (!fname) continue;
+// Documents whose parts add up to less than this are analyzed on the calling thread alone
+const size_t kConcurrentAnalysisMinSize = 1024 * 1024;
 
-        // Process only XML files within the "word/" directory (e.g., document.xml, styles.xml, etc.)
-        if (strncmp(fname, "word/", 5) != 0 || strstr(fname, ".xml") == nullptr)
-            continue;
+// Analyzes the parts on up to threads threads, the calling one included, and merges the results in part order,
+// so the outcome does not depend on which part finished first. mainDocument is the index of the main document
+// in parts, if it is there at all. Returns false, having done nothing, if the parts are too small to be worth it.
+bool AnalyzeWordXmlPartsConcurrently(ArchiveSession& session, const std::vector<std::string>& parts, size_t mainDocument,
+                                     unsigned wants, unsigned threads, WordXmlAnalysis& analysis)
+{
+    if (parts.size() < 2)
+        return false;
 
-        size_t uncompressed_size = 0;
-        void* p = mz_zip_reader_extract_to_heap(&zip_archive, i, &uncompressed_size, 0);
-        if (!p) continue;
+    // Parts whose size is unknown are streamed; the largest parts are started first so that no thread is left
+    // with a big one at the end
+    std::vector<size_t> sizes(parts.size(), SIZE_MAX);
+    size_t totalSize = 0;
+    for (size_t i = 0; i < parts.size(); ++i) {
+        session.GetPartSize(parts[i].c_str(), sizes[i]);
+        totalSize = sizes[i] < SIZE_MAX - totalSize ? totalSize + sizes[i] : SIZE_MAX;
+    }
+    if (totalSize < kConcurrentAnalysisMinSize)
+        return false;
 
-        std::string content(static_cast<char*>(p), uncompressed_size);
-        mz_free(p);
+    std::vector<size_t> order(parts.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sizes[a] > sizes[b]; });
+
+    std::vector<WordXmlAnalysis> results(parts.size());
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t taken = next++; taken < order.size(); taken = next++) {
+            size_t i = order[taken];
+            results[i] = AnalyzeWordXmlPartConcurrently(session, parts[i].c_str(), sizes[i], i == mainDocument, wants);
+        }
+    };
 
-        tinyxml2::XMLDocument doc;
-        if (doc.Parse(content.c_str()) != tinyxml2::XML_SUCCESS) continue;
+    std::vector<std::future<void>> workers;
+    for (unsigned t = 1; t < threads && t < parts.size(); ++t) {
+        try {
+            workers.push_back(std::async(std::launch::async, worker));
+        }
+        catch (const std::system_error&) {
+            break;      // The threads that did start share the parts
+        }
+    }
+    worker();
+    for (std::future<void>& running : workers)
+        running.get();
 
-        tinyxml2::XMLElement* root = doc.RootElement();
-        if (!root) continue;
+    for (const WordXmlAnalysis& result : results)
+        MergeWordXmlAnalysis(analysis, result);
+    return true;
+}
 
-        CountTrackedChangesRecursive(root, counts);
+// Runs the requested analyses over the story parts of the archive, stopping as soon as all of them are settled.
+// Packages without content types or relationships are analyzed through every word/*.xml part instead.
+// Counts and authors need every part anyway, so when they are wanted the parts are analyzed on up to threads
+// threads at once.
+WordXmlAnalysis AnalyzeWordXmlParts(ArchiveSession& session, unsigned wants, unsigned threads)
+{
+    WordXmlAnalysis analysis;
+    bool concurrent = threads > 1 && (wants & (WANT_COUNTS | WANT_AUTHORS)) && session.SupportsConcurrentReads();
+
+    std::vector<std::string> storyParts;
+    if (GetStoryParts(session, storyParts)) {
+        if (!concurrent || !AnalyzeWordXmlPartsConcurrently(session, storyParts, 0, wants, threads, analysis)) {
+            // Only the main document can answer the hidden text question, so it may be the only part inflated
+            for (size_t i = 0; i < storyParts.size() && wants != 0; ++i)
+                AnalyzeWordXmlPart(session, storyParts[i].c_str(), i == 0, wants, analysis);
+        }
+    }
+    else if (wants == WANT_HIDDEN_TEXT) {
+        AnalyzeWordXmlPart(session, "word/document.xml", true, wants, analysis);
+    }
+    else {
+        std::vector<std::string> parts;
+        if (concurrent)
+            session.ForEachWordXmlPart([&](const char* name) { parts.push_back(name); return true; });
+        // word/document.xml comes first if the archive has it
+        size_t mainDocument = !parts.empty() && _stricmp(parts[0].c_str(), "word/document.xml") == 0 ? 0 : SIZE_MAX;
+        if (!concurrent || !AnalyzeWordXmlPartsConcurrently(session, parts, mainDocument, wants, threads, analysis)) {
+            session.ForEachWordXmlPart([&](const char* name)
+                {
+                    AnalyzeWordXmlPart(session, name, _stricmp(name, "word/document.xml") == 0, wants, analysis);
+                    return wants != 0;
+                });
+        }
     }
-    mz_zip_reader_end(&zip_archive);
+
+    TrackedChangeCounts& counts = analysis.counts;
     counts.totalRevisions = counts.insertions + counts.deletions + counts.moves + counts.formattingChanges;
-    return counts;
+    return analysis;
 }
 
 
-// --- Total Commander Content Plugin API ---
+// --- Field value cache ---
+// Total Commander asks for every column separately, so all fields that share the same
+// archive parts are computed together and kept per file until the file changes.
+
+// Fields that are computed together on a cache miss
+enum {
+    GROUP_CORE = 0,
+    GROUP_APP,
+    GROUP_SETTINGS,
+    GROUP_COMMENTS,
+    GROUP_HIDDEN_TEXT,
+    GROUP_TRACKED_CHANGES,
+    GROUP_REVISIONS,
+    GROUP_COUNT
+};
+
+struct FieldValue {
+    int type = ft_fieldempty;   // ft_* code handed back to Total Commander
+    int number = 0;             // ft_numeric_32 and ft_boolean
+    std::string text;           // ft_string
+    FILETIME time = {};         // ft_datetime (UTC)
+};
+
+struct FileIdentity {
+    ULONGLONG size = 0;
+    FILETIME lastWrite = {};
+};
+
+struct CachedDocument {
+    FileIdentity identity;
+    bool groupReady[GROUP_COUNT] = {};
+    FieldValue fields[FIELD_COUNT];
+};
+
+const size_t kMaxCachedDocuments = 512;
+
+static std::mutex g_cacheMutex;
+static std::list<std::pair<std::string, CachedDocument>> g_cacheEntries; // Most recently used first
+static std::unordered_map<std::string, std::list<std::pair<std::string, CachedDocument>>::iterator> g_cacheIndex;
+
+int GetFieldGroup(int fieldIndex)
+{
+    switch (fieldIndex) {
+    case FIELD_CORE_TITLE:
+    case FIELD_CORE_SUBJECT:
+    case FIELD_CORE_CREATOR:
+    case FIELD_CORE_KEYWORDS:
+    case FIELD_CORE_DESCRIPTION:
+    case FIELD_CORE_LAST_MODIFIED_BY:
+    case FIELD_CORE_CREATED_DATE:
+    case FIELD_CORE_MODIFIED_DATE:
+    case FIELD_CORE_LAST_PRINTED_DATE:
+    case FIELD_CORE_REVISION_NUMBER:
+        return GROUP_CORE;
+    case FIELD_APP_MANAGER:
+    case FIELD_APP_COMPANY:
+    case FIELD_APP_HYPERLINK_BASE:
+    case FIELD_APP_TEMPLATE:
+    case FIELD_APP_PAGES:
+    case FIELD_APP_WORDS:
+    case FIELD_APP_CHARACTERS:
+    case FIELD_APP_LINES:
+    case FIELD_APP_PARAGRAPHS:
+    case FIELD_APP_EDITING_TIME:
+        return GROUP_APP;
+    case FIELD_COMPATMODE:
+    case FIELD_DOCUMENT_PROTECTION:
+    case FIELD_AUTO_UPDATE_STYLES:
+    case FIELD_ANONYMISED_FILES:
+    case FIELD_TCS_ON_OFF:
+        return GROUP_SETTINGS;
+    case FIELD_COMMENTS:
+        return GROUP_COMMENTS;
+    case FIELD_HIDDEN_TEXT:
+        return GROUP_HIDDEN_TEXT;
+    case FIELD_TRACKED_CHANGES:
+        return GROUP_TRACKED_CHANGES;
+    case FIELD_AUTHORS:
+    case FIELD_TOTAL_REVISIONS:
+    case FIELD_TOTAL_INSERTIONS:
+    case FIELD_TOTAL_DELETIONS:
+    case FIELD_TOTAL_MOVES:
+    case FIELD_TOTAL_FORMATTING_CHANGES:
+        return GROUP_REVISIONS;
+    default:
+        return -1;
+    }
+}
+
+bool GetFileIdentity(const char* fileName, FileIdentity& identity)
+{
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesExA(fileName, GetFileExInfoStandard, &data))
+        return false;
+
+    identity.size = (static_cast<ULONGLONG>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+    identity.lastWrite = data.ftLastWriteTime;
+    return true;
+}
+
+bool IsSameFile(const FileIdentity& a, const FileIdentity& b)
+{
+    return a.size == b.size &&
+        a.lastWrite.dwLowDateTime == b.lastWrite.dwLowDateTime &&
+        a.lastWrite.dwHighDateTime == b.lastWrite.dwHighDateTime;
+}
+
+// Copies a cached field value if its group has already been computed for this version of the file.
+bool LookupCachedField(const std::string& path, const FileIdentity& identity, int fieldIndex, FieldValue& value)
+{
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+
+    auto it = g_cacheIndex.find(path);
+    if (it == g_cacheIndex.end())
+        return false;
+
+    CachedDocument& doc = it->second->second;
+    if (!IsSameFile(doc.identity, identity) || !doc.groupReady[GetFieldGroup(fieldIndex)])
+        return false;
+
+    g_cacheEntries.splice(g_cacheEntries.begin(), g_cacheEntries, it->second);
+    value = doc.fields[fieldIndex];
+    return true;
+}
+
+// Stores every field of the computed groups, replacing the entry if the file has changed since it was cached.
+void StoreCachedGroups(const std::string& path, const FileIdentity& identity, unsigned groups, const FieldValue* fields)
+{
+    std::lock_guard<std::mutex> lock(g_cacheMutex);
+
+    auto it = g_cacheIndex.find(path);
+    if (it == g_cacheIndex.end()) {
+        g_cacheEntries.emplace_front(path, CachedDocument());
+        g_cacheIndex[path] = g_cacheEntries.begin();
+
+        if (g_cacheEntries.size() > kMaxCachedDocuments) {
+            g_cacheIndex.erase(g_cacheEntries.back().first);
+            g_cacheEntries.pop_back();
+        }
+    }
+    else {
+        g_cacheEntries.splice(g_cacheEntries.begin(), g_cacheEntries, it->second);
+    }
+
+    CachedDocument& doc = g_cacheEntries.front().second;
+    if (!IsSameFile(doc.identity, identity)) {
+        doc = CachedDocument();
+        doc.identity = identity;
+    }
+
+    for (int i = 0; i < FIELD_COUNT; ++i) {
+        if (groups & (1u << GetFieldGroup(i)))
+            doc.fields[i] = fields[i];
+    }
+    for (int group = 0; group < GROUP_COUNT; ++group) {
+        if (groups & (1u << group))
+            doc.groupReady[group] = true;
+    }
+}
+
+// Each thread parses every part into the same document. Parsing resets it without releasing its
+// node pools, so after the first request the DOM is built from recycled memory, up to the arena's
+// retained limit. Parts are parsed in place, so the tree is only valid while the session that owns
+// the part is open; ComputeFieldGroups clears it before the session closes.
+tinyxml2::XMLDocument& GetScratchDocument()
+{
+    thread_local tinyxml2::XMLDocument doc;
+    return doc;
+}
+
+void SetStringField(FieldValue& field, std::string_view text)
+{
+    field.type = text.empty() ? ft_fieldempty : ft_string;
+    field.text.assign(text.data(), text.size());
+}
+
+void SetNumberField(FieldValue& field, int type, int number)
+{
+    field.type = type;
+    field.number = number;
+}
+
+void SetDateField(FieldValue& field, std::string_view dateStr)
+{
+    field.type = ft_fieldempty;
+    if (!dateStr.empty() && ParseIso8601ToFileTime(dateStr, &field.time))
+        field.type = ft_datetime;
+}
+
+void FillCoreFields(ArchiveSession& session, FieldValue* fields)
+{
+    size_t coreSize = 0;
+    char* coreXml = session.TakePart("docProps/core.xml", coreSize);
+    if (!coreXml) {
+        for (int i = 0; i < FIELD_COUNT; ++i) {
+            if (GetFieldGroup(i) == GROUP_CORE)
+                fields[i].type = ft_fileerror;
+        }
+        return;
+    }
+
+    tinyxml2::XMLDocument& doc = GetScratchDocument();
+    tinyxml2::XMLElement* root = nullptr;
+    if (coreSize != 0 && doc.ParseInPlace(coreXml, coreSize) == tinyxml2::XML_SUCCESS)
+        root = doc.RootElement();
+
+    SetStringField(fields[FIELD_CORE_TITLE], GetXmlStringValue(root, "dc:title"));
+    SetStringField(fields[FIELD_CORE_SUBJECT], GetXmlStringValue(root, "dc:subject"));
+    SetStringField(fields[FIELD_CORE_CREATOR], GetXmlStringValue(root, "dc:creator"));
+    SetStringField(fields[FIELD_CORE_KEYWORDS], GetXmlStringValue(root, "cp:keywords"));
+    SetStringField(fields[FIELD_CORE_DESCRIPTION], GetXmlStringValue(root, "dc:description"));
+    SetStringField(fields[FIELD_CORE_LAST_MODIFIED_BY], GetXmlStringValue(root, "cp:lastModifiedBy"));
+    SetDateField(fields[FIELD_CORE_CREATED_DATE], GetXmlStringValue(root, "dcterms:created"));
+    SetDateField(fields[FIELD_CORE_MODIFIED_DATE], GetXmlStringValue(root, "dcterms:modified"));
+    SetDateField(fields[FIELD_CORE_LAST_PRINTED_DATE], GetXmlStringValue(root, "cp:lastPrinted"));
+
+    int revision = GetXmlIntValue(root, "cp:revision");
+    if (revision == 0 && coreSize == 0)
+        fields[FIELD_CORE_REVISION_NUMBER].type = ft_fileerror;
+    else
+        SetNumberField(fields[FIELD_CORE_REVISION_NUMBER], ft_numeric_32, revision);
+}
+
+void FillAppFields(ArchiveSession& session, FieldValue* fields)
+{
+    size_t appSize = 0;
+    char* appXml = session.TakePart("docProps/app.xml", appSize);
+    if (!appXml) {
+        for (int i = 0; i < FIELD_COUNT; ++i) {
+            if (GetFieldGroup(i) == GROUP_APP)
+                fields[i].type = ft_fileerror;
+        }
+        return;
+    }
+
+    tinyxml2::XMLDocument& doc = GetScratchDocument();
+    tinyxml2::XMLElement* root = nullptr;
+    if (appSize != 0 && doc.ParseInPlace(appXml, appSize) == tinyxml2::XML_SUCCESS)
+        root = doc.RootElement();
+
+    SetStringField(fields[FIELD_APP_MANAGER], GetXmlStringValue(root, "Manager"));
+    SetStringField(fields[FIELD_APP_COMPANY], GetXmlStringValue(root, "Company"));
+    SetStringField(fields[FIELD_APP_HYPERLINK_BASE], GetXmlStringValue(root, "HyperlinkBase"));
+    SetStringField(fields[FIELD_APP_TEMPLATE], GetXmlStringValue(root, "Template"));
+
+    if (appSize == 0)
+        fields[FIELD_APP_EDITING_TIME].type = ft_fileerror;
+    else
+        SetNumberField(fields[FIELD_APP_EDITING_TIME], ft_numeric_32, GetXmlIntValue(root, "TotalTime"));
+
+    // Statistics of zero are shown as empty rather than as 0
+    const struct { int field; const char* element; } statistics[] = {
+        { FIELD_APP_PAGES, "Pages" },
+        { FIELD_APP_PARAGRAPHS, "Paragraphs" },
+        { FIELD_APP_LINES, "Lines" },
+        { FIELD_APP_WORDS, "Words" },
+        { FIELD_APP_CHARACTERS, "Characters" },
+    };
+    for (const auto& statistic : statistics) {
+        int value = GetXmlIntValue(root, statistic.element);
+        if (value == 0 && appSize == 0)
+            fields[statistic.field].type = ft_fileerror;
+        else if (value == 0)
+            fields[statistic.field].type = ft_fieldempty;
+        else
+            SetNumberField(fields[statistic.field], ft_numeric_32, value);
+    }
+}
+
+const char* GetDocumentProtection(tinyxml2::XMLElement* root)
+{
+    if (!root) return "No protection";
+
+    tinyxml2::XMLElement* protectionElem = root->FirstChildElement("w:documentProtection");
+    if (!protectionElem) return "No protection";
+
+    const char* enforcement = protectionElem->Attribute("w:enforcement");
+    if (!enforcement || strcmp(enforcement, "1") != 0) return "No protection";
+
+    const char* edit = protectionElem->Attribute("w:edit");
+    if (!edit) return "Unknown protection type";
+    if (strcmp(edit, "readOnly") == 0) return "Read-Only";
+    if (strcmp(edit, "forms") == 0) return "Forms";
+    if (strcmp(edit, "comments") == 0) return "Comments";
+    if (strcmp(edit, "trackedChanges") == 0) return "Tracked Changes";
+    return "Unknown protection type";
+}
+
+void FillSettingsFields(ArchiveSession& session, FieldValue* fields)
+{
+    size_t settingsSize = 0;
+    char* settingsXml = session.TakePart("word/settings.xml", settingsSize);
+    bool hasSettings = settingsXml != nullptr;
+    bool hasDocument = session.HasPart("word/document.xml");
+
+    tinyxml2::XMLDocument& doc = GetScratchDocument();
+    bool parsed = hasSettings && doc.ParseInPlace(settingsXml, settingsSize) == tinyxml2::XML_SUCCESS;
+    tinyxml2::XMLElement* root = parsed ? doc.RootElement() : nullptr;
+
+    if (!hasSettings)
+        fields[FIELD_COMPATMODE].type = ft_fileerror;
+    else
+        SetNumberField(fields[FIELD_COMPATMODE], ft_boolean, IsCompatibilityModeEnabled(root) ? 1 : 0);
+
+    if (settingsSize == 0)
+        fields[FIELD_DOCUMENT_PROTECTION].type = ft_fileerror;
+    else
+        SetStringField(fields[FIELD_DOCUMENT_PROTECTION], parsed ? GetDocumentProtection(root) : "Error parsing settings.xml");
+
+    if (!hasDocument || !hasSettings) {
+        fields[FIELD_AUTO_UPDATE_STYLES].type = ft_fileerror;
+        fields[FIELD_ANONYMISED_FILES].type = ft_fileerror;
+    }
+    else {
+        SetNumberField(fields[FIELD_AUTO_UPDATE_STYLES], ft_boolean, IsAutoUpdateStylesEnabled(root) ? 1 : 0);
+        SetNumberField(fields[FIELD_ANONYMISED_FILES], ft_boolean, AreFilesAnonymised(root) ? 1 : 0);
+    }
+
+    // Track Changes is reported as text even though the column is declared as a boolean
+    if (!hasDocument)
+        fields[FIELD_TCS_ON_OFF].type = ft_fileerror;
+    else
+        SetStringField(fields[FIELD_TCS_ON_OFF], IsTrackChangesEnabled(root) ? "Activated" : "Deactivated");
+}
+
+void FillCommentsFields(ArchiveSession& session, FieldValue* fields)
+{
+    size_t commentsSize = 0;
+    char* commentsXml = session.TakePart("word/comments.xml", commentsSize);
+    int count = 0;
+    tinyxml2::XMLDocument& doc = GetScratchDocument();
+    if (commentsXml && commentsSize != 0 && doc.ParseInPlace(commentsXml, commentsSize) == tinyxml2::XML_SUCCESS)
+        count = CountComments(doc.RootElement());
+    SetNumberField(fields[FIELD_COMMENTS], ft_numeric_32, count);
+}
+
+void FillHiddenTextFields(ArchiveSession& session, const WordXmlAnalysis& analysis, FieldValue* fields)
+{
+    if (!session.HasPart("word/document.xml")) {
+        fields[FIELD_HIDDEN_TEXT].type = ft_fileerror;
+        return;
+    }
+    SetNumberField(fields[FIELD_HIDDEN_TEXT], ft_boolean, analysis.hasHiddenText ? 1 : 0);
+}
+
+void FillTrackedChangesFields(ArchiveSession& session, const WordXmlAnalysis& analysis, FieldValue* fields)
+{
+    if (!session.HasPart("word/document.xml")) {
+        fields[FIELD_TRACKED_CHANGES].type = ft_fileerror;
+        return;
+    }
+    SetNumberField(fields[FIELD_TRACKED_CHANGES], ft_boolean, analysis.hasTrackedChanges ? 1 : 0);
+}
+
+void FillRevisionFields(ArchiveSession& session, const WordXmlAnalysis& analysis, FieldValue* fields)
+{
+    std::stringstream ss;
+    bool first = true;
+    for (const auto& author : analysis.authors)
+    {
+        if (!first) ss << ", ";
+        ss << author;
+        first = false;
+    }
+    SetStringField(fields[FIELD_AUTHORS], ss.str());
+
+    if (!session.HasPart("word/document.xml")) {
+        fields[FIELD_TOTAL_REVISIONS].type = ft_fileerror;
+        fields[FIELD_TOTAL_INSERTIONS].type = ft_fileerror;
+        fields[FIELD_TOTAL_DELETIONS].type = ft_fileerror;
+        fields[FIELD_TOTAL_MOVES].type = ft_fileerror;
+        fields[FIELD_TOTAL_FORMATTING_CHANGES].type = ft_fileerror;
+        return;
+    }
+
+    const TrackedChangeCounts& trackedCounts = analysis.counts;
+    SetNumberField(fields[FIELD_TOTAL_REVISIONS], ft_numeric_32, trackedCounts.totalRevisions);
+    SetNumberField(fields[FIELD_TOTAL_INSERTIONS], ft_numeric_32, trackedCounts.insertions);
+    SetNumberField(fields[FIELD_TOTAL_DELETIONS], ft_numeric_32, trackedCounts.deletions);
+    SetNumberField(fields[FIELD_TOTAL_MOVES], ft_numeric_32, trackedCounts.moves);
+    SetNumberField(fields[FIELD_TOTAL_FORMATTING_CHANGES], ft_numeric_32, trackedCounts.formattingChanges);
+}
+
+// --- Settings ---
+// Read once from the plugin's section of Total Commander's content plugin ini file:
+//   [MSWord_WDX]
+//   ParallelInflateThreads=0       Threads that inflate one large part together; 0 or 1 inflates it on one thread
+//   ParallelInflateMinSizeMB=64    Uncompressed size from which a part is inflated on several threads
+//   PartAnalysisThreads=4          Threads that analyze the parts of one document at once; 0 or 1 analyzes them in turn
+
+const char* const kSettingsSection = "MSWord_WDX";
+const unsigned kMaxSettingThreads = 64;
+
+static unsigned g_parallelInflateThreads = 0;
+static size_t g_parallelInflateMinSize = 64 * 1024 * 1024;
+static unsigned g_partAnalysisThreads = 4;
+
+void LoadSettings(const char* iniName)
+{
+    unsigned threads = GetPrivateProfileIntA(kSettingsSection, "ParallelInflateThreads", 0, iniName);
+    g_parallelInflateThreads = threads < kMaxSettingThreads ? threads : kMaxSettingThreads;
+    g_parallelInflateMinSize = size_t(GetPrivateProfileIntA(kSettingsSection, "ParallelInflateMinSizeMB", 64, iniName)) * 1024 * 1024;
+    threads = GetPrivateProfileIntA(kSettingsSection, "PartAnalysisThreads", 4, iniName);
+    g_partAnalysisThreads = threads < kMaxSettingThreads ? threads : kMaxSettingThreads;
+}
+
+// --- Field query planner ---
+// Archive parts read by each group. A group's parts must be inflated (or, for
+// document.xml in the settings group, merely exist) before its fields can be filled.
+enum {
+    PART_CORE_XML = 1 << 0,
+    PART_APP_XML = 1 << 1,
+    PART_SETTINGS_XML = 1 << 2,
+    PART_COMMENTS_XML = 1 << 3,
+    PART_DOCUMENT_XML = 1 << 4,
+    PART_ANY_WORD_XML = 1 << 5,     // word/*.xml parts, scanned only until the first revision
+    PART_ALL_WORD_XML = 1 << 6,     // every word/*.xml part, scanned completely
+};
+
+unsigned GetGroupParts(int group)
+{
+    switch (group) {
+    case GROUP_CORE:            return PART_CORE_XML;
+    case GROUP_APP:             return PART_APP_XML;
+    case GROUP_SETTINGS:        return PART_SETTINGS_XML;
+    case GROUP_COMMENTS:        return PART_COMMENTS_XML;
+    case GROUP_HIDDEN_TEXT:     return PART_DOCUMENT_XML;
+    case GROUP_TRACKED_CHANGES: return PART_ANY_WORD_XML;
+    case GROUP_REVISIONS:       return PART_ALL_WORD_XML;
+    default:                    return 0;
+    }
+}
+
+// Plans which groups to compute for a request: the requested group plus every other group
+// whose parts are inflated anyway, so they ride along for free. The revision traversal reads
+// the story parts, which include word/comments.xml but not word/settings.xml.
+unsigned PlanFieldGroups(int requestedGroup)
+{
+    unsigned parts = GetGroupParts(requestedGroup);
+    if (parts & PART_ALL_WORD_XML)
+        parts |= PART_COMMENTS_XML | PART_DOCUMENT_XML | PART_ANY_WORD_XML;
+
+    unsigned groups = 0;
+    for (int group = 0; group < GROUP_COUNT; ++group) {
+        if ((GetGroupParts(group) & ~parts) == 0)
+            groups |= 1u << group;
+    }
+    return groups;
+}
+
+// Computes every field of the planned groups from a single archive session.
+// verifyCrc can be false when the results are cached against the file's size and write time: every field is read-only
+// metadata, and a damaged deflate stream or a size mismatch still fails extraction.
+// Once cancelled is set the archive reads fail and the fields are incomplete; the caller must discard them.
+void ComputeFieldGroups(const char* fileName, unsigned groups, FieldValue* fields, bool verifyCrc, const std::atomic<bool>& cancelled)
+{
+    ArchiveSession session(fileName, PreferredArchiveBackend(fileName), ARCHIVE_INDEX_HASHED);
+    session.SetVerifyCrc(verifyCrc);
+    session.SetCancelFlag(&cancelled);
+    session.SetParallelInflate(g_parallelInflateThreads, g_parallelInflateMinSize);
+
+    unsigned wants = 0;
+    if (groups & (1u << GROUP_REVISIONS))       wants |= WANT_COUNTS | WANT_AUTHORS;
+    if (groups & (1u << GROUP_TRACKED_CHANGES)) wants |= WANT_PRESENCE;
+    if (groups & (1u << GROUP_HIDDEN_TEXT))     wants |= WANT_HIDDEN_TEXT;
+
+    // Archives on network shares fetch every part known to be needed in one batch of reads
+    std::vector<std::string> plannedParts;
+    if (groups & (1u << GROUP_CORE))            plannedParts.push_back("docProps/core.xml");
+    if (groups & (1u << GROUP_APP))             plannedParts.push_back("docProps/app.xml");
+    if (groups & (1u << GROUP_SETTINGS))        plannedParts.push_back("word/settings.xml");
+    if (groups & (1u << GROUP_COMMENTS))        plannedParts.push_back("word/comments.xml");
+    if (wants != 0) {
+        plannedParts.push_back("[Content_Types].xml");
+        plannedParts.push_back("word/_rels/document.xml.rels");
+        plannedParts.push_back("word/document.xml");
+    }
+    session.PrefetchParts(plannedParts);
+
+    // All revision-related groups share one traversal of the story parts. Comments are one of them, and the
+    // fallback over every word/*.xml part also reads settings; both are extracted first when their groups are
+    // wanted, so the traversal reads them from memory before they are parsed in place.
+    if (wants != 0) {
+        if (groups & (1u << GROUP_SETTINGS))    session.GetPart("word/settings.xml");
+        if (groups & (1u << GROUP_COMMENTS))    session.GetPart("word/comments.xml");
+
+        WordXmlAnalysis analysis = AnalyzeWordXmlParts(session, wants, g_partAnalysisThreads);
+        if (groups & (1u << GROUP_REVISIONS))       FillRevisionFields(session, analysis, fields);
+        if (groups & (1u << GROUP_TRACKED_CHANGES)) FillTrackedChangesFields(session, analysis, fields);
+        if (groups & (1u << GROUP_HIDDEN_TEXT))     FillHiddenTextFields(session, analysis, fields);
+    }
+
+    if (groups & (1u << GROUP_SETTINGS))        FillSettingsFields(session, fields);
+    if (groups & (1u << GROUP_COMMENTS))        FillCommentsFields(session, fields);
+    if (groups & (1u << GROUP_CORE))            FillCoreFields(session, fields);
+    if (groups & (1u << GROUP_APP))             FillAppFields(session, fields);
+
+    // The tree points into the session's parts. Clearing it now also trims the arena of a large document
+    // instead of keeping it until the thread's next parse.
+    GetScratchDocument().Clear();
+}
+
+// --- Cancellation ---
+// Total Commander calls ContentStopGetValue when it no longer needs the value being computed for a file, e.g.
+// because the user has left the directory. Every computation registers itself here, and its archive session
+// checks the flag between chunks.
+
+struct FieldRequest {
+    std::string path;
+    std::atomic<bool> cancelled{ false };
+};
+
+static std::mutex g_requestMutex;
+static std::list<FieldRequest*> g_fieldRequests;
+static bool g_allFieldRequestsCancelled = false;   // Set while the plugin unloads; later requests start cancelled
+
+// Registers a computation for the file for the lifetime of the object
+class FieldRequestScope {
+public:
+    explicit FieldRequestScope(const std::string& path)
+    {
+        m_request.path = path;
+        std::lock_guard<std::mutex> lock(g_requestMutex);
+        m_request.cancelled = g_allFieldRequestsCancelled;
+        g_fieldRequests.push_back(&m_request);
+    }
+
+    ~FieldRequestScope()
+    {
+        std::lock_guard<std::mutex> lock(g_requestMutex);
+        g_fieldRequests.remove(&m_request);
+    }
+
+    FieldRequestScope(const FieldRequestScope&) = delete;
+    FieldRequestScope& operator=(const FieldRequestScope&) = delete;
+
+    const std::atomic<bool>& Cancelled() const { return m_request.cancelled; }
+    bool IsCancelled() const { return m_request.cancelled.load(); }
+
+private:
+    FieldRequest m_request;
+};
+
+void CancelFieldRequests(const char* path)
+{
+    std::lock_guard<std::mutex> lock(g_requestMutex);
+    for (FieldRequest* request : g_fieldRequests) {
+        if (request->path == path)
+            request->cancelled = true;
+    }
+}
+
+void CancelAllFieldRequests()
+{
+    std::lock_guard<std::mutex> lock(g_requestMutex);
+    g_allFieldRequestsCancelled = true;
+    for (FieldRequest* request : g_fieldRequests)
+        request->cancelled = true;
+}
+
+// --- Background evaluation ---
+// Groups that read the word/*.xml story parts can take seconds on large documents. When Total Commander asks
+// for one of their fields with CONTENT_DELAYIFSLOW, the answer is ft_delayed and the groups are computed on a
+// worker thread. Total Commander then asks again from its own background thread; that call finds the fields
+// cached, waits for the worker, or computes them itself if the worker has not got to the file yet.
+
+struct Evaluation {
+    std::string path;
+    FileIdentity identity;
+    unsigned groups = 0;        // Only extended while the evaluation has not started
+    bool started = false;
+    bool done = false;
+};
+
+const size_t kMaxQueuedEvaluations = 256;
+
+static std::mutex g_evaluationMutex;
+static std::condition_variable g_evaluationChanged;
+static std::list<std::shared_ptr<Evaluation>> g_evaluations;   // Queued and running, oldest first
+static bool g_evaluationWorkerRunning = false;
+static bool g_evaluationsStopped = false;
+
+// Joined by StopEvaluations, or by the next start once it has finished. Never destroyed, as a std::thread that is
+// still joinable at process exit would terminate it.
+std::thread& EvaluationWorkerThread()
+{
+    static std::thread* worker = new std::thread();
+    return *worker;
+}
+
+bool IsSlowGroup(int group)
+{
+    return (GetGroupParts(group) & (PART_DOCUMENT_XML | PART_ANY_WORD_XML | PART_ALL_WORD_XML)) != 0;
+}
+
+// Computes and caches the groups of an evaluation that the calling thread has marked as started
+void RunEvaluation(const std::shared_ptr<Evaluation>& evaluation)
+{
+    try {
+        FieldRequestScope request(evaluation->path);
+        FieldValue fields[FIELD_COUNT];
+        ComputeFieldGroups(evaluation->path.c_str(), evaluation->groups, fields, false, request.Cancelled());
+        if (!request.IsCancelled())
+            StoreCachedGroups(evaluation->path, evaluation->identity, evaluation->groups, fields);
+    }
+    catch (const std::bad_alloc&) {
+        // Nothing is cached, so the next request for the fields computes them inline
+    }
+
+    std::lock_guard<std::mutex> lock(g_evaluationMutex);
+    evaluation->done = true;
+    g_evaluations.remove(evaluation);
+    g_evaluationChanged.notify_all();
+}
+
+// Runs queued evaluations until none are left, then exits
+void EvaluationWorker()
+{
+    std::unique_lock<std::mutex> lock(g_evaluationMutex);
+    while (!g_evaluationsStopped) {
+        auto next = std::find_if(g_evaluations.begin(), g_evaluations.end(),
+            [](const std::shared_ptr<Evaluation>& evaluation) { return !evaluation->started; });
+        if (next == g_evaluations.end())
+            break;
+
+        std::shared_ptr<Evaluation> evaluation = *next;
+        evaluation->started = true;
+        lock.unlock();
+        RunEvaluation(evaluation);
+        lock.lock();
+    }
+    g_evaluationWorkerRunning = false;
+    g_evaluationChanged.notify_all();
+}
+
+// Queues the groups for the worker, adding them to a queued evaluation of the same file if there is one
+void QueueEvaluation(const std::string& path, const FileIdentity& identity, unsigned groups)
+{
+    std::lock_guard<std::mutex> lock(g_evaluationMutex);
+    if (g_evaluationsStopped)
+        return;
+
+    size_t queued = 0;
+    for (const std::shared_ptr<Evaluation>& evaluation : g_evaluations) {
+        if (evaluation->path == path && IsSameFile(evaluation->identity, identity)) {
+            if ((evaluation->groups & groups) == groups)
+                return;
+            if (!evaluation->started) {
+                evaluation->groups |= groups;
+                return;
+            }
+        }
+        queued += evaluation->started ? 0 : 1;
+    }
+
+    // Files scrolled past long ago go first; nobody waits for an evaluation that has not started
+    if (queued >= kMaxQueuedEvaluations) {
+        auto oldest = std::find_if(g_evaluations.begin(), g_evaluations.end(),
+            [](const std::shared_ptr<Evaluation>& evaluation) { return !evaluation->started; });
+        g_evaluations.erase(oldest);
+    }
+
+    std::shared_ptr<Evaluation> evaluation = std::make_shared<Evaluation>();
+    evaluation->path = path;
+    evaluation->identity = identity;
+    evaluation->groups = groups;
+    g_evaluations.push_back(evaluation);
+
+    if (!g_evaluationWorkerRunning) {
+        // A previous worker has left its loop and needs no lock to finish
+        std::thread& worker = EvaluationWorkerThread();
+        if (worker.joinable())
+            worker.join();
+        try {
+            worker = std::thread(EvaluationWorker);
+            g_evaluationWorkerRunning = true;
+        }
+        catch (const std::system_error&) {
+            // The follow-up request computes the fields itself
+            g_evaluations.pop_back();
+        }
+    }
+}
+
+// For a cache miss without CONTENT_DELAYIFSLOW: waits for a running evaluation of the file that covers the group,
+// or takes over a queued one, which the caller then runs with RunEvaluation. Returns the evaluation taken over.
+std::shared_ptr<Evaluation> AwaitOrClaimEvaluation(const std::string& path, const FileIdentity& identity, int group)
+{
+    std::unique_lock<std::mutex> lock(g_evaluationMutex);
+    std::shared_ptr<Evaluation> running;
+    for (const std::shared_ptr<Evaluation>& evaluation : g_evaluations) {
+        if (evaluation->path != path || !IsSameFile(evaluation->identity, identity))
+            continue;
+        if (!evaluation->started) {
+            evaluation->groups |= PlanFieldGroups(group);
+            evaluation->started = true;
+            return evaluation;
+        }
+        if (evaluation->groups & (1u << group))
+            running = evaluation;
+    }
+
+    if (running)
+        g_evaluationChanged.wait(lock, [&] { return running->done; });
+    return nullptr;
+}
+
+// Forgets the queued evaluations of the file; a running one is cancelled through its FieldRequestScope
+void DropQueuedEvaluations(const char* path)
+{
+    std::lock_guard<std::mutex> lock(g_evaluationMutex);
+    g_evaluations.remove_if([&](const std::shared_ptr<Evaluation>& evaluation) { return !evaluation->started && evaluation->path == path; });
+}
+
+// Drops the queued evaluations, cancels the running ones and joins the worker, so that no thread is left in the plugin
+void StopEvaluations()
+{
+    std::thread worker;
+    {
+        std::lock_guard<std::mutex> lock(g_evaluationMutex);
+        g_evaluationsStopped = true;
+        g_evaluations.remove_if([](const std::shared_ptr<Evaluation>& evaluation) { return !evaluation->started; });
+        worker.swap(EvaluationWorkerThread());
+    }
+
+    CancelAllFieldRequests();
+    if (worker.joinable())
+        worker.join();
+}
+
+// Copies a field value into Total Commander's buffer and returns the matching ft_* code.
+int WriteFieldValue(const FieldValue& value, int unitIndex, void* fieldValue, int maxLen)
+{
+    switch (value.type) {
+    case ft_string:
+        strncpy_s(static_cast<char*>(fieldValue), maxLen, value.text.c_str(), _TRUNCATE);
+        static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
+        return ft_string;
+    case ft_numeric_32:
+    case ft_boolean:
+        *(int*)fieldValue = value.number;
+        return value.type;
+    case ft_datetime:
+        if (unitIndex == 0) {
+            memcpy(fieldValue, &value.time, sizeof(FILETIME));
+            return ft_datetime;
+        }
+        if (FormatSystemTimeToString(value.time, unitIndex, static_cast<wchar_t*>(fieldValue), maxLen / sizeof(wchar_t))) {
+            return ft_stringw;
+        }
+        return ft_fieldempty;
+    default:
+        return value.type;
+    }
+}
+
+// --- Total Commander Content Plugin API ---
 
 extern "C" {
 
@@ -880,440 +1873,61 @@ extern "C" {
         if (len < 5 || _stricmp(fileName + len - 5, ".docx") != 0)
             return ft_fieldempty;
 
-        std::string documentXml;
-        std::string commentsXml;
-        std::string settingsXml;
-        std::string coreXml;
-        std::string appXml;
-
-        bool needsCoreXml = false;
-        bool needsAppXml = false;
-        bool needsWordXml = false;
-        bool needsCommentsXml = false;
-        bool needsSettingsXml = false;
-
-        // Determine which XML files are needed based on the fieldIndex
-        switch (fieldIndex) {
-            case FIELD_CORE_TITLE:
-            case FIELD_CORE_SUBJECT:
-            case FIELD_CORE_CREATOR:
-            case FIELD_CORE_KEYWORDS:
-            case FIELD_CORE_DESCRIPTION:
-            case FIELD_CORE_LAST_MODIFIED_BY:
-            case FIELD_CORE_CREATED_DATE:
-            case FIELD_CORE_MODIFIED_DATE:
-            case FIELD_CORE_LAST_PRINTED_DATE:
-            case FIELD_CORE_REVISION_NUMBER:
-                needsCoreXml = true;
-                break;
-            case FIELD_APP_MANAGER:
-            case FIELD_APP_COMPANY:
-            case FIELD_APP_HYPERLINK_BASE:
-            case FIELD_APP_TEMPLATE:
-            case FIELD_APP_PAGES:
-            case FIELD_APP_WORDS:
-            case FIELD_APP_CHARACTERS:
-            case FIELD_APP_LINES:
-            case FIELD_APP_PARAGRAPHS:
-            case FIELD_APP_EDITING_TIME:
-                needsAppXml = true;
-                break;
-            case FIELD_COMPATMODE:
-            case FIELD_COMMENTS:
-                needsCommentsXml = true;
-                break;
-            case FIELD_DOCUMENT_PROTECTION:
-                needsSettingsXml = true;
-                break;
-            case FIELD_AUTO_UPDATE_STYLES:
-            case FIELD_ANONYMISED_FILES:
-            case FIELD_TCS_ON_OFF:
-            case FIELD_HIDDEN_TEXT:
-            case FIELD_TRACKED_CHANGES:
-            case FIELD_TOTAL_REVISIONS:
-            case FIELD_TOTAL_INSERTIONS:
-            case FIELD_TOTAL_DELETIONS:
-            case FIELD_TOTAL_MOVES:
-            case FIELD_TOTAL_FORMATTING_CHANGES:
-                needsWordXml = true;
-                break;
-            case FIELD_AUTHORS:
-                break;
-            default:
-                break;
-        }
-
-        if (needsCoreXml) {
-            if (!ExtractFileFromZip(fileName, "docProps/core.xml", coreXml)) {
-                return ft_fileerror;
-            }
-        }
-        if (needsAppXml) {
-            if (!ExtractFileFromZip(fileName, "docProps/app.xml", appXml)) {
-                return ft_fileerror;
-            }
-        }
-        if (needsCommentsXml) {
-            if (!ExtractFileFromZip(fileName, "word/comments.xml", commentsXml)) {
-                commentsXml = "";
-            }
-        }
-        if (needsSettingsXml) {
-            if (!ExtractFileFromZip(fileName, "word/settings.xml", settingsXml)) {
-                return ft_fileerror;
-            }
-        }
-        if (needsWordXml) {
-            if (!ExtractFileFromZip(fileName, "word/document.xml", documentXml)) {
-                return ft_fileerror;
-            }
-        }
-
-        TrackedChangeCounts trackedCounts;
-        if (fieldIndex >= FIELD_TOTAL_REVISIONS && fieldIndex <= FIELD_TOTAL_FORMATTING_CHANGES) {
-            trackedCounts = GetTrackedChangeCounts(fileName); // Call the updated function
-        }
-
-
-        switch (fieldIndex)
-        {
-        case FIELD_CORE_TITLE:
-        {
-            std::string title = GetXmlStringValue(coreXml, "dc:title");
-            if (title.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, title.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_CORE_SUBJECT:
-        {
-            std::string subject = GetXmlStringValue(coreXml, "dc:subject");
-            if (subject.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, subject.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_CORE_CREATOR:
-        {
-            std::string creator = GetXmlStringValue(coreXml, "dc:creator");
-            if (creator.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, creator.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_APP_MANAGER:
-        {
-            std::string manager = GetXmlStringValue(appXml, "Manager");
-            if (manager.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, manager.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_APP_COMPANY:
-        {
-            std::string company = GetXmlStringValue(appXml, "Company");
-            if (company.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, company.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_CORE_KEYWORDS:
-        {
-            std::string keywords = GetXmlStringValue(coreXml, "cp:keywords");
-            if (keywords.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, keywords.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_CORE_DESCRIPTION:
-        {
-            std::string description = GetXmlStringValue(coreXml, "dc:description");
-            if (description.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, description.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_APP_HYPERLINK_BASE:
-        {
-            std::string hyperlinkBase = GetXmlStringValue(appXml, "HyperlinkBase");
-            if (hyperlinkBase.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, hyperlinkBase.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_APP_TEMPLATE:
-        {
-            std::string templateName = GetXmlStringValue(appXml, "Template");
-            if (templateName.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, templateName.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_CORE_CREATED_DATE:
-        case FIELD_CORE_MODIFIED_DATE:
-        case FIELD_CORE_LAST_PRINTED_DATE:
-        {
-            std::string dateStr;
-            if (fieldIndex == FIELD_CORE_CREATED_DATE) dateStr = GetXmlStringValue(coreXml, "dcterms:created");
-            else if (fieldIndex == FIELD_CORE_MODIFIED_DATE) dateStr = GetXmlStringValue(coreXml, "dcterms:modified");
-            else if (fieldIndex == FIELD_CORE_LAST_PRINTED_DATE) dateStr = GetXmlStringValue(coreXml, "cp:lastPrinted");
-
-            if (dateStr.empty()) return ft_fieldempty;
-
-            FILETIME ft_utc;
-            if (!ParseIso8601ToFileTime(dateStr, &ft_utc)) {
-                return ft_fieldempty;
-            }
-
-            if (unitIndex == 0) {
-                memcpy(fieldValue, &ft_utc, sizeof(FILETIME));
-                return ft_datetime;
-            }
-            else {
-                if (FormatSystemTimeToString(ft_utc, unitIndex, static_cast<wchar_t*>(fieldValue), maxLen / sizeof(wchar_t))) {
-                    return ft_stringw;
-                }
-                return ft_fieldempty;
-            }
-        }
-        case FIELD_CORE_LAST_MODIFIED_BY:
-        {
-            std::string lastModifiedBy = GetXmlStringValue(coreXml, "cp:lastModifiedBy");
-            if (lastModifiedBy.empty()) return ft_fieldempty;
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, lastModifiedBy.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_CORE_REVISION_NUMBER:
-        {
-            int revision = GetXmlIntValue(coreXml, "cp:revision");
-            if (revision == 0 && coreXml.empty()) return ft_fileerror;
-            *(int*)fieldValue = revision;
-            return ft_numeric_32;
-        }
-        case FIELD_APP_EDITING_TIME:
-        {
-            int editTime = GetXmlIntValue(appXml, "TotalTime");
-            if (appXml.empty()) return ft_fileerror;
-            *(int*)fieldValue = editTime;
-            return ft_numeric_32;
-        }
-        case FIELD_APP_PAGES:
-        {
-            int pages = GetXmlIntValue(appXml, "Pages");
-            if (pages == 0 && appXml.empty()) return ft_fileerror;
-            if (pages == 0) return ft_fieldempty;
-            *(int*)fieldValue = pages;
-            return ft_numeric_32;
-        }
-        case FIELD_APP_PARAGRAPHS:
-        {
-            int paragraphs = GetXmlIntValue(appXml, "Paragraphs");
-            if (paragraphs == 0 && appXml.empty()) return ft_fileerror;
-            if (paragraphs == 0) return ft_fieldempty;
-            *(int*)fieldValue = paragraphs;
-            return ft_numeric_32;
-        }
-        case FIELD_APP_LINES:
-        {
-            int lines = GetXmlIntValue(appXml, "Lines");
-            if (lines == 0 && appXml.empty()) return ft_fileerror;
-            if (lines == 0) return ft_fieldempty;
-            *(int*)fieldValue = lines;
-            return ft_numeric_32;
-        }
-        case FIELD_APP_WORDS:
-        {
-            int words = GetXmlIntValue(appXml, "Words");
-            if (words == 0 && appXml.empty()) return ft_fileerror;
-            if (words == 0) return ft_fieldempty;
-            *(int*)fieldValue = words;
-            return ft_numeric_32;
-        }
-        case FIELD_APP_CHARACTERS:
-        {
-            int characters = GetXmlIntValue(appXml, "Characters");
-            if (characters == 0 && appXml.empty()) return ft_fileerror;
-            if (characters == 0) return ft_fieldempty;
-            *(int*)fieldValue = characters;
-            return ft_numeric_32;
-        }
-
-        case FIELD_COMPATMODE:
-        {
-            if (!ExtractFileFromZip(fileName, "word/settings.xml", settingsXml))
-                return ft_fileerror;
-
-            *((int*)fieldValue) = IsCompatibilityModeEnabled(settingsXml) ? 1 : 0;
-            return ft_boolean;
-        }
-        case FIELD_HIDDEN_TEXT:
-        {
-            bool hasHidden = HasHiddenTextInDocumentXml(fileName);
-            *((int*)fieldValue) = hasHidden ? 1 : 0;
-            return ft_boolean;
-        }
-        case FIELD_COMMENTS:
-        {
-            int commentCount = CountComments(commentsXml);
-            *(int*)fieldValue = commentCount;
-            return ft_numeric_32;
-        }
-        case FIELD_DOCUMENT_PROTECTION:
-        {
-            if (settingsXml.empty()) return ft_fileerror;
-
-            tinyxml2::XMLDocument doc;
-            if (doc.Parse(settingsXml.c_str()) != tinyxml2::XML_SUCCESS) {
-                strncpy_s(static_cast<char*>(fieldValue), maxLen, "Error parsing settings.xml", _TRUNCATE);
-                static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-                return ft_string;
-            }
-
-            tinyxml2::XMLElement* root = doc.RootElement();
-            if (!root) {
-                strncpy_s(static_cast<char*>(fieldValue), maxLen, "No protection", _TRUNCATE);
-                static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-                return ft_string;
-            }
+        int group = GetFieldGroup(fieldIndex);
+        if (group < 0)
+            return ft_nomorefields;
 
-            tinyxml2::XMLElement* protectionElem = root->FirstChildElement("w:documentProtection");
-            std::string protectionType = "No protection";
-
-            if (protectionElem) {
-                const char* enforcement = protectionElem->Attribute("w:enforcement");
-                if (enforcement && strcmp(enforcement, "1") == 0) {
-                    const char* edit = protectionElem->Attribute("w:edit");
-                    if (edit) {
-                        if (strcmp(edit, "readOnly") == 0) {
-                            protectionType = "Read-Only";
-                        }
-                        else if (strcmp(edit, "forms") == 0) {
-                            protectionType = "Forms";
-                        }
-                        else if (strcmp(edit, "comments") == 0) {
-                            protectionType = "Comments";
-                        }
-                        else if (strcmp(edit, "trackedChanges") == 0) {
-                            protectionType = "Tracked Changes";
-                        }
-                        else {
-                            protectionType = "Unknown protection type";
-                        }
-                    }
-                    else {
-                        protectionType = "Unknown protection type";
-                    }
-                }
+        FieldValue value;
+        FileIdentity identity;
+        bool cacheable = GetFileIdentity(fileName, identity);
+        bool cached = cacheable && LookupCachedField(fileName, identity, fieldIndex, value);
+        if (!cached) {
+            if (cacheable && (flags & CONTENT_DELAYIFSLOW) && IsSlowGroup(group)) {
+                QueueEvaluation(fileName, identity, PlanFieldGroups(group));
+                return ft_delayed;
             }
 
-            strncpy_s(static_cast<char*>(fieldValue), maxLen, protectionType.c_str(), _TRUNCATE);
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-
-        case FIELD_AUTO_UPDATE_STYLES:
-        {
-            if (!ExtractFileFromZip(fileName, "word/settings.xml", settingsXml)) {
-                return ft_fileerror;
-            }
-            if (IsAutoUpdateStylesEnabled(settingsXml)) {
-                *(int*)fieldValue = 1;
-            }
-            else {
-                *(int*)fieldValue = 0;
-            }
-            return ft_boolean;
-        }
-        case FIELD_ANONYMISED_FILES:
-        {
-            if (!ExtractFileFromZip(fileName, "word/settings.xml", settingsXml)) {
-                return ft_fileerror;
+            // After ContentStopGetValue for the file nothing is cached and the field is left empty
+            FieldRequestScope request(fileName);
+            if (cacheable) {
+                if (std::shared_ptr<Evaluation> claimed = AwaitOrClaimEvaluation(fileName, identity, group))
+                    RunEvaluation(claimed);
+                cached = LookupCachedField(fileName, identity, fieldIndex, value);
             }
-            if (AreFilesAnonymised(settingsXml)) {
-                *(int*)fieldValue = 1;
+            if (!cached) {
+                unsigned groups = PlanFieldGroups(group);
+                FieldValue fields[FIELD_COUNT];
+                if (!request.IsCancelled())
+                    ComputeFieldGroups(fileName, groups, fields, !cacheable, request.Cancelled());
+                if (request.IsCancelled())
+                    return ft_fieldempty;
+                if (cacheable)
+                    StoreCachedGroups(fileName, identity, groups, fields);
+                value = fields[fieldIndex];
             }
-            else {
-                *(int*)fieldValue = 0;
-            }
-            return ft_boolean;
         }
-        case FIELD_TRACKED_CHANGES:
-        {
-            bool hasChanges = HasTrackedChanges(fileName); // Call the updated function
-            *((int*)fieldValue) = hasChanges ? 1 : 0;
-            return ft_boolean;
-        }
-        case FIELD_TCS_ON_OFF:
-        {
-            std::string settingsXml;
-            
-            if (!ExtractFileFromZip(fileName, "word/settings.xml", settingsXml)) {
-                strncpy_s(static_cast<char*>(fieldValue), maxLen, "Deactivated", _TRUNCATE);
-                static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-                return ft_string;
-            }
 
-            if (IsTrackChangesEnabled(settingsXml)) {
-                strncpy_s(static_cast<char*>(fieldValue), maxLen, "Activated", _TRUNCATE);
-            }
-            else {
-                strncpy_s(static_cast<char*>(fieldValue), maxLen, "Deactivated", _TRUNCATE);
-            }
-            static_cast<char*>(fieldValue)[maxLen - 1] = '\0';
-            return ft_string;
-        }
-        case FIELD_AUTHORS:
-        {
-            auto authors = GetTrackedChangeAuthorsFromAllXml(fileName);
-            if (authors.empty())
-                return ft_fieldempty;
-
-            std::stringstream ss;
-            bool first = true;
-            for (const auto& author : authors)
-            {
-                if (!first) ss << ", ";
-                ss << author;
-                first = false;
-            }
-            std::string result = ss.str();
+        return WriteFieldValue(value, unitIndex, fieldValue, maxLen);
+    }
 
-            char* pStr = static_cast<char*>(fieldValue);
-            strncpy_s(pStr, maxLen, result.c_str(), _TRUNCATE);
-            pStr[maxLen - 1] = '\0';
+    // Called by Total Commander from the main thread to abort ContentGetValue for the file
+    __declspec(dllexport) void __stdcall ContentStopGetValue(char* fileName)
+    {
+        DropQueuedEvaluations(fileName);
+        CancelFieldRequests(fileName);
+    }
 
-            return ft_string;
-        }
-        case FIELD_TOTAL_REVISIONS:
-        {
-            *(int*)fieldValue = trackedCounts.totalRevisions;
-            return ft_numeric_32;
-        }
-        case FIELD_TOTAL_INSERTIONS:
-        {
-            *(int*)fieldValue = trackedCounts.insertions;
-            return ft_numeric_32;
-        }
-        case FIELD_TOTAL_DELETIONS:
-        {
-            *(int*)fieldValue = trackedCounts.deletions;
-            return ft_numeric_32;
-        }
-        case FIELD_TOTAL_MOVES:
-        {
-            *(int*)fieldValue = trackedCounts.moves;
-            return ft_numeric_32;
-        }
-        case FIELD_TOTAL_FORMATTING_CHANGES:
-        {
-            *(int*)fieldValue = trackedCounts.formattingChanges;
-            return ft_numeric_32;
-        }
+    // Called by Total Commander right after loading the plugin
+    __declspec(dllexport) void __stdcall ContentSetDefaultParams(ContentDefaultParamStruct* dps)
+    {
+        LoadSettings(dps->DefaultIniName);
+    }
 
-        default:
-            return ft_nomorefields;
-        }
+    // Called by Total Commander before the plugin is unloaded
+    __declspec(dllexport) void __stdcall ContentPluginUnloading(void)
+    {
+        StopEvaluations();
+        CloseArchiveReaders();
     }
 
 }
@@ -0,0 +1,252 @@
+#include "simdscan.h"
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || (defined(__i386__) && defined(__SSE2__))
+#define SIMDSCAN_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(SIMDSCAN_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMDSCAN_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMDSCAN_TARGET_AVX2
+#endif
+
+namespace {
+
+int CountTrailingZeros(uint64_t mask)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+    unsigned long index;
+    _BitScanForward64(&index, mask);
+    return static_cast<int>(index);
+#elif defined(_MSC_VER)
+    unsigned long index;
+    if (_BitScanForward(&index, static_cast<unsigned long>(mask)))
+        return static_cast<int>(index);
+    _BitScanForward(&index, static_cast<unsigned long>(mask >> 32));
+    return static_cast<int>(index) + 32;
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+bool IsStructural(char c)
+{
+    return c == '<' || c == '>' || c == '"' || c == '\'';
+}
+
+// Classifies up to 64 bytes, leaving the bits past size clear
+uint64_t StructuralMaskScalar(const char* p, size_t size)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < size; ++i) {
+        if (IsStructural(p[i]))
+            mask |= uint64_t(1) << i;
+    }
+    return mask;
+}
+
+#ifdef SIMDSCAN_X86
+
+uint64_t StructuralMaskSse2(const char* p)
+{
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i dq = _mm_set1_epi8('"');
+    const __m128i sq = _mm_set1_epi8('\'');
+
+    uint64_t mask = 0;
+    for (int i = 0; i < 4; ++i) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i * 16));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt)),
+                                    _mm_or_si128(_mm_cmpeq_epi8(v, dq), _mm_cmpeq_epi8(v, sq)));
+        mask |= static_cast<uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(hits))) << (i * 16);
+    }
+    return mask;
+}
+
+SIMDSCAN_TARGET_AVX2 uint64_t StructuralMaskAvx2(const char* p)
+{
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i dq = _mm256_set1_epi8('"');
+    const __m256i sq = _mm256_set1_epi8('\'');
+
+    uint64_t mask = 0;
+    for (int i = 0; i < 2; ++i) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i * 32));
+        __m256i hits = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt), _mm256_cmpeq_epi8(v, gt)),
+                                       _mm256_or_si256(_mm256_cmpeq_epi8(v, dq), _mm256_cmpeq_epi8(v, sq)));
+        mask |= static_cast<uint64_t>(static_cast<unsigned>(_mm256_movemask_epi8(hits))) << (i * 32);
+    }
+    return mask;
+}
+
+// Searches every start position below the returned offset; the caller checks the rest
+size_t FindPatternsSse2(const char* const* patterns, const size_t* lengths, int count, size_t maxLength,
+                        const char* data, size_t size, bool& found)
+{
+    size_t i = 0;
+    for (; i + maxLength + 15 <= size; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        for (int k = 0; k < count; ++k) {
+            __m128i last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + lengths[k] - 1));
+            __m128i hits = _mm_and_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(patterns[k][0])),
+                                         _mm_cmpeq_epi8(last, _mm_set1_epi8(patterns[k][lengths[k] - 1])));
+            for (unsigned mask = _mm_movemask_epi8(hits); mask != 0; mask &= mask - 1) {
+                if (memcmp(data + i + CountTrailingZeros(mask), patterns[k], lengths[k]) == 0) {
+                    found = true;
+                    return i;
+                }
+            }
+        }
+    }
+    found = false;
+    return i;
+}
+
+SIMDSCAN_TARGET_AVX2 size_t FindPatternsAvx2(const char* const* patterns, const size_t* lengths, int count, size_t maxLength,
+                                             const char* data, size_t size, bool& found)
+{
+    size_t i = 0;
+    for (; i + maxLength + 31 <= size; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        for (int k = 0; k < count; ++k) {
+            __m256i last = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + lengths[k] - 1));
+            __m256i hits = _mm256_and_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(patterns[k][0])),
+                                            _mm256_cmpeq_epi8(last, _mm256_set1_epi8(patterns[k][lengths[k] - 1])));
+            for (unsigned mask = _mm256_movemask_epi8(hits); mask != 0; mask &= mask - 1) {
+                if (memcmp(data + i + CountTrailingZeros(mask), patterns[k], lengths[k]) == 0) {
+                    found = true;
+                    return i;
+                }
+            }
+        }
+    }
+    found = false;
+    return i;
+}
+
+bool CpuHasAvx2()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+    // AVX2 also needs the OS to save the YMM registers
+    __cpuid(info, 1);
+    if ((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+        return false;
+    if ((_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+#else
+
+uint64_t StructuralMaskBlock(const char* p)
+{
+    return StructuralMaskScalar(p, 64);
+}
+
+#endif
+
+typedef uint64_t (*StructuralMaskFn)(const char* p);
+typedef size_t (*FindPatternsFn)(const char* const* patterns, const size_t* lengths, int count, size_t maxLength,
+                                 const char* data, size_t size, bool& found);
+
+struct Kernels {
+    StructuralMaskFn structuralMask;
+    FindPatternsFn findPatterns;     // nullptr if there is no vector kernel
+};
+
+Kernels SelectKernels()
+{
+#ifdef SIMDSCAN_X86
+    if (CpuHasAvx2())
+        return { StructuralMaskAvx2, FindPatternsAvx2 };
+    return { StructuralMaskSse2, FindPatternsSse2 };
+#else
+    return { StructuralMaskBlock, nullptr };
+#endif
+}
+
+const Kernels g_kernels = SelectKernels();
+
+} // namespace
+
+void StructuralIndex::LoadBlock(const char* blockStart)
+{
+    m_block = blockStart;
+    m_loaded = true;
+    size_t remaining = m_end - blockStart;
+    m_mask = remaining >= 64 ? g_kernels.structuralMask(blockStart) : StructuralMaskScalar(blockStart, remaining);
+}
+
+const char* StructuralIndex::Next(const char* p)
+{
+    while (p < m_end) {
+        if (!m_loaded || p < m_block || p >= m_block + 64)
+            LoadBlock(p);
+        uint64_t mask = m_mask >> (p - m_block);
+        if (mask)
+            return p + CountTrailingZeros(mask);
+        p = m_block + 64;
+    }
+    return m_end;
+}
+
+void PatternSet::Add(const char* pattern)
+{
+    size_t length = strlen(pattern);
+    if (length == 0)
+        return;
+    if (m_count == kMaxPatterns) {
+        m_overflow = true;
+        return;
+    }
+    m_patterns[m_count] = pattern;
+    m_lengths[m_count] = length;
+    m_count++;
+    if (length > m_maxLength)
+        m_maxLength = length;
+}
+
+bool PatternSet::FoundIn(const char* data, size_t size) const
+{
+    if (m_overflow)
+        return true;
+
+    size_t scanned = 0;
+    if (g_kernels.findPatterns) {
+        bool found = false;
+        scanned = g_kernels.findPatterns(m_patterns, m_lengths, m_count, m_maxLength, data, size, found);
+        if (found)
+            return true;
+    }
+
+    // Start positions the vector kernel could not reach without reading past the buffer
+    for (int k = 0; k < m_count; ++k) {
+        const char* p = data + scanned;
+        const char* end = data + size;
+        size_t length = m_lengths[k];
+        while (static_cast<size_t>(end - p) >= length) {
+            p = static_cast<const char*>(memchr(p, m_patterns[k][0], end - p - length + 1));
+            if (!p)
+                break;
+            if (memcmp(p, m_patterns[k], length) == 0)
+                return true;
+            ++p;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// --- Vectorized byte scanning ---
+// SSE2 and AVX2 kernels with a scalar fallback. The widest kernel the CPU supports is picked once,
+// while the module's statics are initialized at load time.
+
+// Walks the structural characters of XML markup ('<', '>', '"' and '\'') through a buffer. Each
+// 64-byte block is classified with vector compares into a bitmask, and positions are then taken
+// from the mask one bit at a time, so runs of text or attribute values cost a few instructions.
+class StructuralIndex
+{
+public:
+    StructuralIndex(const char* begin, const char* end) : m_end(end), m_block(begin), m_mask(0), m_loaded(false) {}
+
+    // First structural character at or after p, or the end of the buffer
+    const char* Next(const char* p);
+
+    // First occurrence of c at or after p, which must be one of the structural characters
+    const char* Find(const char* p, char c)
+    {
+        p = Next(p);
+        while (p < m_end && *p != c)
+            p = Next(p + 1);
+        return p;
+    }
+
+private:
+    void LoadBlock(const char* blockStart);
+
+    const char* m_end;
+    const char* m_block;    // Start of the classified block
+    uint64_t m_mask;        // Bit i is set if m_block[i] is structural
+    bool m_loaded;
+};
+
+// A few byte strings looked for in a single pass over a buffer. Candidates are found by comparing the
+// first and last byte of every pattern at each position with vector compares; only positions where
+// both match are checked in full.
+class PatternSet
+{
+public:
+    static const int kMaxPatterns = 8;
+
+    // Adds a pattern; the string is not copied and must outlive the set. Once more than kMaxPatterns have
+    // been added, FoundIn answers true for every buffer so that the set never rules out too much.
+    void Add(const char* pattern);
+    bool Empty() const { return m_count == 0; }
+
+    // True if any of the patterns occurs in the buffer
+    bool FoundIn(const char* data, size_t size) const;
+
+private:
+    const char* m_patterns[kMaxPatterns];
+    size_t m_lengths[kMaxPatterns];
+    int m_count = 0;
+    size_t m_maxLength = 0;
+    bool m_overflow = false;
+};
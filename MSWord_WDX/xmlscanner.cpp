@@ -0,0 +1,329 @@
+#include "xmlscanner.h"
+#include "simdscan.h"
+#include <cstring>
+
+namespace {
+
+bool IsXmlSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+const char* SkipSpace(const char* p, const char* end)
+{
+    while (p < end && IsXmlSpace(*p))
+        ++p;
+    return p;
+}
+
+const char* FindSequence(const char* p, const char* end, const char* sequence)
+{
+    size_t length = strlen(sequence);
+    while (p + length <= end) {
+        const char* hit = static_cast<const char*>(memchr(p, sequence[0], end - p - length + 1));
+        if (!hit)
+            return nullptr;
+        if (memcmp(hit, sequence, length) == 0)
+            return hit;
+        p = hit + 1;
+    }
+    return nullptr;
+}
+
+void AppendUtf8(std::string& out, unsigned long codePoint)
+{
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000) {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Decodes entity references and normalises line breaks the same way tinyxml2 does for attribute values.
+void DecodeAttributeValue(const char* p, const char* end, std::string& out)
+{
+    static const struct { const char* text; size_t length; char value; } entities[] = {
+        { "quot;", 5, '"' }, { "amp;", 4, '&' }, { "apos;", 5, '\'' }, { "lt;", 3, '<' }, { "gt;", 3, '>' },
+    };
+
+    out.clear();
+    while (p < end) {
+        if (*p == '\r') {
+            out += '\n';
+            p += (p + 1 < end && p[1] == '\n') ? 2 : 1;
+            continue;
+        }
+        if (*p != '&') {
+            out += *p++;
+            continue;
+        }
+
+        const char* q = p + 1;
+        if (q < end && *q == '#') {
+            unsigned long codePoint = 0;
+            bool hex = q + 1 < end && q[1] == 'x';
+            const char* digits = q + (hex ? 2 : 1);
+            const char* d = digits;
+            for (; d < end && *d != ';'; ++d) {
+                char c = *d;
+                int digit = (c >= '0' && c <= '9') ? c - '0'
+                    : (hex && c >= 'a' && c <= 'f') ? c - 'a' + 10
+                    : (hex && c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+                if (digit < 0 || codePoint > 0x10FFFF) break;
+                codePoint = codePoint * (hex ? 16 : 10) + digit;
+            }
+            if (d < end && *d == ';' && d > digits && codePoint <= 0x10FFFF) {
+                AppendUtf8(out, codePoint);
+                p = d + 1;
+                continue;
+            }
+        }
+        else {
+            bool matched = false;
+            for (const auto& entity : entities) {
+                if (static_cast<size_t>(end - q) >= entity.length && memcmp(q, entity.text, entity.length) == 0) {
+                    out += entity.value;
+                    p = q + entity.length;
+                    matched = true;
+                    break;
+                }
+            }
+            if (matched)
+                continue;
+        }
+
+        // Unknown or malformed reference, keep it as written
+        out += *p++;
+    }
+}
+
+const char* ScanName(const char* p, const char* end)
+{
+    while (p < end && !IsXmlSpace(*p) && *p != '>' && *p != '/' && *p != '=')
+        ++p;
+    return p;
+}
+
+} // namespace
+
+bool XmlToken::Equals(const char* text) const
+{
+    return strncmp(data, text, length) == 0 && text[length] == '\0';
+}
+
+bool XmlAttributes::Find(const char* name, std::string& value) const
+{
+    size_t nameLength = strlen(name);
+    const char* p = m_begin;
+    while (true) {
+        p = SkipSpace(p, m_end);
+        const char* nameEnd = ScanName(p, m_end);
+        if (nameEnd == p)
+            return false;
+
+        const char* q = SkipSpace(nameEnd, m_end);
+        if (q >= m_end || *q != '=')
+            return false;
+        q = SkipSpace(q + 1, m_end);
+        if (q >= m_end || (*q != '"' && *q != '\''))
+            return false;
+
+        const char* valueBegin = q + 1;
+        const char* valueEnd = static_cast<const char*>(memchr(valueBegin, *q, m_end - valueBegin));
+        if (!valueEnd)
+            return false;
+
+        if (static_cast<size_t>(nameEnd - p) == nameLength && memcmp(p, name, nameLength) == 0) {
+            DecodeAttributeValue(valueBegin, valueEnd, value);
+            return true;
+        }
+        p = valueEnd + 1;
+    }
+}
+
+namespace {
+
+// Scans as much markup as the buffer holds. consumed is set to the start of markup that is cut off by the
+// end of the buffer, or to size if everything was scanned.
+XmlScanResult ScanMarkup(const char* data, size_t size, XmlScanHandler& handler, size_t& consumed)
+{
+    const char* p = data;
+    const char* end = data + size;
+    StructuralIndex index(data, end);
+
+    while (p < end) {
+        const char* lt = index.Find(p, '<');
+        if (lt >= end)
+            break;
+        p = lt + 1;
+        consumed = lt - data;
+        if (p >= end)
+            return XML_SCAN_OK;
+
+        if (*p == '/') {
+            XmlToken name;
+            name.data = p + 1;
+            name.length = ScanName(name.data, end) - name.data;
+            const char* gt = index.Find(name.data + name.length, '>');
+            if (gt >= end)
+                return XML_SCAN_OK;
+            if (name.length == 0)
+                return XML_SCAN_ERROR;
+            if (!handler.EndElement(name))
+                return XML_SCAN_STOPPED;
+            p = gt + 1;
+        }
+        else if (*p == '?') {
+            const char* close = FindSequence(p, end, "?>");
+            if (!close)
+                return XML_SCAN_OK;
+            p = close + 2;
+        }
+        else if (*p == '!') {
+            const char* close = nullptr;
+            if (end - p >= 3 && memcmp(p, "!--", 3) == 0) {
+                close = FindSequence(p + 3, end, "-->");
+                if (close) close += 3;
+            }
+            else if (end - p >= 8 && memcmp(p, "![CDATA[", 8) == 0) {
+                close = FindSequence(p + 8, end, "]]>");
+                if (close) close += 3;
+            }
+            else {
+                // <!DOCTYPE ...> possibly with an internal subset in brackets
+                int brackets = 0;
+                for (const char* q = p; q < end; ++q) {
+                    if (*q == '[') brackets++;
+                    else if (*q == ']') brackets--;
+                    else if (*q == '>' && brackets <= 0) { close = q + 1; break; }
+                }
+            }
+            if (!close)
+                return XML_SCAN_OK;
+            p = close;
+        }
+        else {
+            XmlToken name;
+            name.data = p;
+            name.length = ScanName(p, end) - p;
+            if (name.length == 0 && p + name.length < end)
+                return XML_SCAN_ERROR;
+
+            // Find the end of the tag, skipping over quoted attribute values that may contain '>'
+            const char* q = name.data + name.length;
+            const char* gt = nullptr;
+            while ((q = index.Next(q)) < end) {
+                if (*q == '"' || *q == '\'') {
+                    const char* quote = index.Find(q + 1, *q);
+                    if (quote >= end)
+                        return XML_SCAN_OK;
+                    q = quote + 1;
+                }
+                else if (*q == '>') {
+                    gt = q;
+                    break;
+                }
+                else {
+                    ++q;
+                }
+            }
+            if (!gt)
+                return XML_SCAN_OK;
+
+            bool empty = gt[-1] == '/' && gt - 1 >= name.data + name.length;
+            XmlAttributes attributes(name.data + name.length, empty ? gt - 1 : gt);
+            if (!handler.StartElement(name, attributes))
+                return XML_SCAN_STOPPED;
+            if (empty && !handler.EndElement(name))
+                return XML_SCAN_STOPPED;
+            p = gt + 1;
+        }
+    }
+
+    consumed = size;
+    return XML_SCAN_OK;
+}
+
+// A comment, CDATA section or processing instruction that is cut off is skipped as a whole, so its body need not
+// be kept: only the opening delimiter and the last bytes, which may be the start of the closing one, are. Rescanning
+// the carry then costs the same for every chunk however long the section is.
+void TrimSkippedSection(std::string& carry)
+{
+    static const struct { const char* open; size_t keep; } kSections[] = {
+        { "<!--", 2 },
+        { "<![CDATA[", 2 },
+        { "<?", 1 },
+    };
+    for (const auto& section : kSections) {
+        size_t openLength = strlen(section.open);
+        if (carry.compare(0, openLength, section.open) != 0)
+            continue;
+        if (carry.size() > openLength + section.keep)
+            carry.erase(openLength, carry.size() - openLength - section.keep);
+        return;
+    }
+}
+
+} // namespace
+
+XmlScanResult XmlScanner::Feed(const char* data, size_t size)
+{
+    const char* p = data;
+    const char* end = data + size;
+
+    // Finish the markup left over from the previous chunk first. Normally a tag needs no more than the
+    // bytes up to the next '>', but long tags are topped up with whole chunks instead. Comments, CDATA and
+    // processing instructions are trimmed by TrimSkippedSection, so they stay short however long they are.
+    while (!m_carry.empty() && p < end) {
+        const char* gt = m_carry.size() < 4096 ? static_cast<const char*>(memchr(p, '>', end - p)) : nullptr;
+        const char* take = gt ? gt + 1 : end;
+        m_carry.append(p, take - p);
+        p = take;
+
+        size_t consumed = 0;
+        XmlScanResult result = ScanMarkup(m_carry.data(), m_carry.size(), m_handler, consumed);
+        if (result != XML_SCAN_OK) {
+            m_carry.clear();
+            return result;
+        }
+        m_carry.erase(0, consumed);
+        TrimSkippedSection(m_carry);
+    }
+
+    if (p < end) {
+        size_t consumed = 0;
+        XmlScanResult result = ScanMarkup(p, end - p, m_handler, consumed);
+        if (result != XML_SCAN_OK)
+            return result;
+        m_carry.assign(p + consumed, end);
+        TrimSkippedSection(m_carry);
+    }
+    return XML_SCAN_OK;
+}
+
+XmlScanResult XmlScanner::Finish()
+{
+    XmlScanResult result = m_carry.empty() ? XML_SCAN_OK : XML_SCAN_ERROR;
+    m_carry.clear();
+    return result;
+}
+
+XmlScanResult ScanXml(const char* data, size_t size, XmlScanHandler& handler)
+{
+    XmlScanner scanner(handler);
+    XmlScanResult result = scanner.Feed(data, size);
+    return result == XML_SCAN_OK ? scanner.Finish() : result;
+}
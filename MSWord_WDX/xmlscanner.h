@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// --- Streaming XML scanner ---
+// Reports start and end tags as they are found, without building a tree. Text, comments,
+// processing instructions and CDATA are skipped. The analyzers only need element names and
+// a couple of attributes, so memory use does not depend on the size of the part.
+
+// A run of characters inside the scanned buffer. Not NUL-terminated and only valid during the callback.
+struct XmlToken
+{
+    const char* data = nullptr;
+    size_t length = 0;
+
+    bool Equals(const char* text) const;
+    std::string ToString() const { return std::string(data, length); }
+};
+
+// Raw attribute text of a start tag; attributes are only parsed when asked for.
+class XmlAttributes
+{
+public:
+    XmlAttributes(const char* begin, const char* end) : m_begin(begin), m_end(end) {}
+
+    // Finds an attribute by its qualified name and decodes its value. Returns false if absent.
+    bool Find(const char* name, std::string& value) const;
+
+private:
+    const char* m_begin;
+    const char* m_end;
+};
+
+class XmlScanHandler
+{
+public:
+    virtual ~XmlScanHandler() {}
+
+    // Return false from either callback to stop the scan. Empty elements (<a/>) report both events.
+    virtual bool StartElement(const XmlToken& name, const XmlAttributes& attributes) = 0;
+    virtual bool EndElement(const XmlToken& name) = 0;
+};
+
+enum XmlScanResult {
+    XML_SCAN_OK = 0,
+    XML_SCAN_STOPPED,       // The handler asked to stop
+    XML_SCAN_ERROR,         // Truncated or malformed markup
+};
+
+// Incremental scanner for documents that arrive in chunks, e.g. straight out of the inflater.
+// Only markup that straddles two chunks is copied, so memory use is bounded by the largest tag.
+class XmlScanner
+{
+public:
+    explicit XmlScanner(XmlScanHandler& handler) : m_handler(handler) {}
+
+    // Scans the next chunk of the document
+    XmlScanResult Feed(const char* data, size_t size);
+
+    // Call after the last chunk; reports an error if the document ended inside markup
+    XmlScanResult Finish();
+
+private:
+    XmlScanHandler& m_handler;
+    std::string m_carry;    // Start of markup that continues in the next chunk
+};
+
+// Scans a document that is already complete in memory
+XmlScanResult ScanXml(const char* data, size_t size, XmlScanHandler& handler);
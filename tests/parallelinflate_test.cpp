@@ -0,0 +1,246 @@
+// Differential test of ParallelInflate against tinfl. Streams of several kinds are compressed with tdefl and
+// inflated both ways at several thread counts. Whatever ParallelInflate returns, the bytes it delivered plus the
+// rest of tinfl's output after skipping as many bytes, which is what ArchiveSession does after FAILED, must equal
+// tinfl's output.
+//
+// Build and run from the repository root:
+//   cl /std:c++17 /EHsc /O2 /IMSWord_WDX /IMSWord_WDX\libs tests\parallelinflate_test.cpp MSWord_WDX\parallelinflate.cpp
+//      MSWord_WDX\libs\miniz.c MSWord_WDX\libs\miniz_tdef.c MSWord_WDX\libs\miniz_tinfl.c && parallelinflate_test
+//   gcc -O2 -c -IMSWord_WDX/libs MSWord_WDX/libs/miniz.c MSWord_WDX/libs/miniz_tdef.c MSWord_WDX/libs/miniz_tinfl.c
+//   g++ -std=c++17 -O2 -IMSWord_WDX -IMSWord_WDX/libs tests/parallelinflate_test.cpp MSWord_WDX/parallelinflate.cpp
+//      miniz*.o -lpthread -o parallelinflate_test && ./parallelinflate_test
+
+#include "parallelinflate.h"
+#include "miniz.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::vector<unsigned char> Bytes;
+
+// --- Test data ---
+
+enum DataKind {
+    DATA_TEXT,          // WordprocessingML-like markup
+    DATA_RANDOM,        // Incompressible, so tdefl falls back to stored blocks
+    DATA_RLE,           // Long runs and short periods
+    DATA_MIXED,         // Text with incompressible stretches, giving stored blocks between Huffman ones
+};
+
+void AppendText(Bytes& out, size_t size, std::mt19937& rng)
+{
+    static const char* const kWords[] = { "contract", "party", "shall", "the", "of", "agreement", "<w:r>", "<w:t>",
+        "</w:t></w:r>", "hereinafter", "<w:ins w:id=\"", "\" w:author=\"Jane\">", "</w:ins>", "payment", "clause",
+        "<w:p>", "</w:p>\n", "obligation", " ", " ", ", " };
+    const size_t wordCount = sizeof(kWords) / sizeof(kWords[0]);
+    size_t end = out.size() + size;
+    while (out.size() < end) {
+        const char* word = kWords[rng() % wordCount];
+        out.insert(out.end(), word, word + strlen(word));
+        if (rng() % 7 == 0) {
+            std::string number = std::to_string(rng() % 100000);
+            out.insert(out.end(), number.begin(), number.end());
+        }
+    }
+    out.resize(end);
+}
+
+void AppendRandom(Bytes& out, size_t size, std::mt19937& rng)
+{
+    for (size_t i = 0; i < size; ++i)
+        out.push_back(static_cast<unsigned char>(rng()));
+}
+
+Bytes MakeData(DataKind kind, size_t size, unsigned seed)
+{
+    std::mt19937 rng(seed);
+    Bytes data;
+    data.reserve(size);
+    switch (kind) {
+    case DATA_TEXT:
+        AppendText(data, size, rng);
+        break;
+    case DATA_RANDOM:
+        AppendRandom(data, size, rng);
+        break;
+    case DATA_RLE:
+        while (data.size() < size) {
+            size_t run = 1 + rng() % 2000;
+            unsigned period = 1 + rng() % 12;
+            unsigned char pattern[12];
+            for (unsigned i = 0; i < period; ++i)
+                pattern[i] = static_cast<unsigned char>(rng() % 4);
+            for (size_t i = 0; i < run; ++i)
+                data.push_back(pattern[i % period]);
+        }
+        break;
+    case DATA_MIXED:
+        while (data.size() < size) {
+            AppendText(data, 64 * 1024 + rng() % (256 * 1024), rng);
+            AppendRandom(data, 16 * 1024 + rng() % (128 * 1024), rng);
+        }
+        break;
+    }
+    data.resize(size);
+    return data;
+}
+
+// --- Deflate and reference inflate ---
+
+Bytes Deflate(const Bytes& data, int level, int strategy)
+{
+    mz_uint flags = tdefl_create_comp_flags_from_zip_params(level, -MZ_DEFAULT_WINDOW_BITS, strategy);
+    size_t size = 0;
+    void* compressed = tdefl_compress_mem_to_heap(data.data(), data.size(), &size, static_cast<int>(flags));
+    Bytes result;
+    if (compressed)
+        result.assign(static_cast<unsigned char*>(compressed), static_cast<unsigned char*>(compressed) + size);
+    mz_free(compressed);
+    return result;
+}
+
+int AppendOutput(const void* data, int size, void* user)
+{
+    Bytes* out = static_cast<Bytes*>(user);
+    out->insert(out->end(), static_cast<const unsigned char*>(data), static_cast<const unsigned char*>(data) + size);
+    return 1;
+}
+
+// tinfl's output, as far as it gets on a corrupt stream; ok tells whether it got through the final block
+Bytes Inflate(const Bytes& compressed, bool& ok)
+{
+    Bytes out;
+    size_t size = compressed.size();
+    ok = tinfl_decompress_mem_to_callback(compressed.data(), &size, AppendOutput, &out, 0) != 0;
+    return out;
+}
+
+// --- Checks ---
+
+int g_checks = 0;
+int g_failures = 0;
+int g_takeovers = 0;        // FAILED results after some output was delivered
+
+void Check(const char* label, const Bytes& compressed, const Bytes& reference, bool referenceOk, unsigned threads,
+           size_t stopAfter = 0)
+{
+    Bytes got;
+    uint64_t delivered = 0;
+    ParallelInflateStatus status = ParallelInflate(compressed.data(), compressed.size(), threads,
+        [&](const char* data, size_t size) {
+            got.insert(got.end(), data, data + size);
+            return stopAfter == 0 || got.size() < stopAfter;
+        }, delivered);
+
+    bool ok = delivered == got.size() && got.size() <= reference.size() &&
+              memcmp(got.data(), reference.data(), got.size()) == 0;
+    switch (status) {
+    case PARALLEL_INFLATE_DONE:
+        ok = ok && referenceOk && got.size() == reference.size();
+        break;
+    case PARALLEL_INFLATE_STOPPED:
+        ok = ok && stopAfter != 0 && got.size() >= stopAfter;
+        break;
+    case PARALLEL_INFLATE_FAILED:
+        // The sequential takeover continues from delivered, so the prefix check above covers it
+        if (delivered > 0)
+            g_takeovers++;
+        break;
+    }
+
+    g_checks++;
+    if (!ok) {
+        g_failures++;
+        printf("FAIL %-24s threads=%u compressed=%zu expected=%zu status=%d delivered=%llu\n", label, threads,
+               compressed.size(), reference.size(), status, static_cast<unsigned long long>(delivered));
+    }
+}
+
+struct StreamCase
+{
+    const char* name;
+    DataKind kind;
+    size_t size;
+    int level;
+    int strategy;
+};
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int corruptions = argc > 1 ? atoi(argv[1]) : 100;
+
+    const StreamCase cases[] = {
+        { "text level 6", DATA_TEXT, 24u << 20, 6, MZ_DEFAULT_STRATEGY },
+        { "text level 1", DATA_TEXT, 24u << 20, 1, MZ_DEFAULT_STRATEGY },
+        { "text level 9", DATA_TEXT, 16u << 20, 9, MZ_DEFAULT_STRATEGY },
+        { "text huffman only", DATA_TEXT, 12u << 20, 6, MZ_HUFFMAN_ONLY },
+        { "text fixed huffman", DATA_TEXT, 12u << 20, 6, MZ_FIXED },
+        { "text stored", DATA_TEXT, 6u << 20, 0, MZ_DEFAULT_STRATEGY },
+        { "random", DATA_RANDOM, 6u << 20, 6, MZ_DEFAULT_STRATEGY },
+        { "rle", DATA_RLE, 32u << 20, 6, MZ_RLE },
+        { "rle default", DATA_RLE, 32u << 20, 6, MZ_DEFAULT_STRATEGY },
+        { "mixed stored and huffman", DATA_MIXED, 24u << 20, 6, MZ_DEFAULT_STRATEGY },
+    };
+    const unsigned kThreadCounts[] = { 1, 2, 3, 4, 8 };
+
+    std::vector<Bytes> streams;
+    std::vector<Bytes> references;
+    for (const StreamCase& c : cases) {
+        Bytes data = MakeData(c.kind, c.size, 1234);
+        Bytes compressed = Deflate(data, c.level, c.strategy);
+        bool ok = false;
+        Bytes reference = Inflate(compressed, ok);
+        if (compressed.empty() || !ok || reference != data) {
+            printf("FAIL %-24s tdefl/tinfl round trip\n", c.name);
+            return 1;
+        }
+
+        for (unsigned threads : kThreadCounts)
+            Check(c.name, compressed, reference, true, threads);
+        Check(c.name, compressed, reference, true, 4, data.size() / 3);
+
+        // Cut short, the last chunk fails after the others were delivered
+        Bytes truncated(compressed.begin(), compressed.begin() + compressed.size() * 9 / 10);
+        Bytes partial = Inflate(truncated, ok);
+        Check(c.name, truncated, partial, ok, 4);
+
+        streams.push_back(std::move(compressed));
+        references.push_back(std::move(reference));
+    }
+
+    for (size_t size : { 0, 1, 100, 70000 }) {
+        Bytes compressed = Deflate(MakeData(DATA_TEXT, size, 7), 6, MZ_DEFAULT_STRATEGY);
+        bool ok = false;
+        Bytes reference = Inflate(compressed, ok);
+        Check("small", compressed, reference, ok, 4);
+    }
+
+    // Flipped bits and cut streams; wherever tinfl fails or decodes garbage, ParallelInflate may only deliver a
+    // prefix of what it produced
+    std::mt19937 rng(99);
+    for (int i = 0; i < corruptions; ++i) {
+        Bytes compressed = streams[rng() % streams.size()];
+        int flips = 1 + rng() % 4;
+        for (int f = 0; f < flips; ++f)
+            compressed[rng() % compressed.size()] ^= static_cast<unsigned char>(1u << (rng() % 8));
+        if (rng() % 4 == 0)
+            compressed.resize(rng() % compressed.size());
+        bool ok = false;
+        Bytes reference = Inflate(compressed, ok);
+        Check("corrupt", compressed, reference, ok, 2 + rng() % 6);
+    }
+
+    if (g_takeovers == 0) {
+        printf("FAIL no case exercised the sequential takeover after a partial delivery\n");
+        g_failures++;
+    }
+    printf("%d checks, %d takeovers, %d failures\n", g_checks, g_takeovers, g_failures);
+    return g_failures == 0 ? 0 : 1;
+}